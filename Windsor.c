@@ -25,54 +25,69 @@
 //******************************************************************************
 //  Global Variables
 //******************************************************************************
-byte                adcData[3];
-byte                adcFullScale;
+byte                adcData[TEST_SHOTS];
 signed long         adcReading;
-long                adcScale;
-byte                adcZero;
-short int           calStartCal;
-short int           dataClear;
+byte                calState;
 byte                dataTestNumber;
 int32         distance;
+byte                downloadState;
 long                eepromMemPtr;
-short int           keyClear;
-signed              keyCount;
-short int           keyCountNew;
-short int           keyEnterEscape;
-signed              keyMax;
-signed              keyMin;
-short int           keyNewDetection;
-short int           keySet;
 byte                lcdData[16];
 byte                lcdPosition;
-short int           menuInitSubmenu;
-byte                menuLocationNum;
-short int           menuShowSubmenu;
+PerfCounter         perfCounters[PERF_COUNT];
+byte                saveRecord[TEST_SET_SIZE];
+byte                saveState;
+byte                settingState;
+byte                settingValue[SETTING_COUNT];
+Settings            settings;
+byte                showCache[SHOW_CACHE_SIZE][RECORD_TIME_SIZE];
+byte                showCacheFirst;
+short int           showDate;
 short int           showTest;
-short int           showTime;
-short int           showTitle;
-byte                submenuAggSize;
-byte                submenuDensity;
-byte                submenuMohs;
-byte                submenuPower;
-short int           submenuSetAggSize;
-short int           submenuSetDensity;
-short int           submenuSetMohs;
-short int           submenuSetPower;
-short int           submenuSetUnits;
-short int           submenuSetWeight;
-byte                submenuUnits;
-byte                submenuWeight;
+#ifdef AUTO_ADVANCE
+short int           shotArmed;
+signed long         shotLast;
+signed long         shotPrevious;
+byte                shotSettleCount;
+#endif
+Statistics          statistics;
+byte                summaryView;
+int32               tableEntry;
+short int           tableReady;
 short int           testClearT;
-short int           testDone;
-short int           testError;
-short int           testOk;
 byte                testSetCount;
 //short int           testSetCount;
+Settings            testSettings;
 short int           testShowT;
+byte                testState;
+byte                testUploaded;
 byte                timeRTCData[7];
 short int           timeSetClock;
-short int           timeUpdate;
+byte                uartBuffer[UART_BUFFER_SIZE];
+byte                uartHead;
+byte                uartTail;
+
+// Main loop state, in common RAM.  The main loop flags share one byte.
+signed              keyCount;
+signed              keyMax;
+signed              keyMin;
+byte                mainFlags;
+byte                menuLocationNum;
+byte                menuState;
+#locate keyCount = RAM_KEY_COUNT
+#locate keyMax = RAM_KEY_MAX
+#locate keyMin = RAM_KEY_MIN
+#locate mainFlags = RAM_MAIN_FLAGS
+#locate menuLocationNum = RAM_MENU_LOCATION
+#locate menuState = RAM_MENU_STATE
+#bit keyClear = mainFlags.0
+#bit keyCountNew = mainFlags.1
+#bit keyNewDetection = mainFlags.2
+#bit keySet = mainFlags.3
+#bit shotSettled = mainFlags.4
+#bit showTime = mainFlags.5
+#bit showTitle = mainFlags.6
+#bit timeUpdate = mainFlags.7
 
 
 //******************************************************************************
@@ -81,49 +96,134 @@ short int           timeUpdate;
 
 //******************************************************************************
 //
-//  Function: Config_initialize()
+//  Function: Config_addStatistics()
+//
+//  Description:
+//  ============
+//  This function adds the strength of the passed test record to the
+//  statistics of its power setting.  A block that fails its check is left
+//  for Config_rebuildStatistics() to repair.
+//
+//******************************************************************************
+void Config_addStatistics(byte *record)
+{
+  byte              group;
+
+  group = record[RECORD_POWER] - SUBMENU_POWER_STD;
+  if ((group >= STATS_GROUPS) || !Config_loadStatistics(group))
+  {
+    return;
+  }
+  Config_addStrength(&statistics, Display_calculateStrength(record));
+  Config_saveStatistics(group);
+}
+
+
+//******************************************************************************
+//
+//  Function: Config_addStrength()
+//
+//  Description:
+//  ============
+//  This function adds the passed strength to the passed statistics block.
+//
+//******************************************************************************
+#inline
+void Config_addStrength(Statistics *s, long strength)
+{
+  if (!s->count || (strength < s->low))
+  {
+    s->low = strength;
+  }
+  if (!s->count || (strength > s->high))
+  {
+    s->high = strength;
+  }
+  ++s->count;
+  s->sum += strength;
+  s->squares += (int32) strength * strength;
+}
+
+
+//******************************************************************************
+//
+//  Function: Config_checkStatistics()
 //
 //  Description:
 //  ============
-//  This function initializes most global variables.
+//  This function returns the check byte of the statistics block: the sum of
+//  its other bytes plus STATS_CHECK_SEED, so a blank or zeroed EEPROM fails.
+//
+//******************************************************************************
+byte Config_checkStatistics(void)
+{
+  byte              check;
+  byte              i;
+
+  check = STATS_CHECK_SEED - statistics.check;
+  for (i = 0 ; i < STATS_SIZE ; i++)
+  {
+    check += ((byte *) &statistics)[i];
+  }
+  return (check);
+}
+
+
+//******************************************************************************
 //
-//  NOTE: The initializations of submenuSetAggSize, submenuSetPower, and
-//        submenuSetUnits have been commented out due to code memory space.
-//        They should be added back in if code memory is conserved someplace
-//        else.
+//  Function: Config_getMenuChild()
+//
+//  Description:
+//  ============
+//  This function returns the child menu of the passed menu that is selected by
+//  keyCount.
+//
+//******************************************************************************
+byte Config_getMenuChild(byte parent)
+{
+  byte              menu;
+
+  menu = MENU_MEASURE;
+  while (MENU_TABLE[menu].parent != parent)
+  {
+    ++menu;
+  }
+  return (menu + keyCount - MENU_TABLE[parent].keyMin);
+}
+
+
+//******************************************************************************
+//
+//  Function: Config_initialize()
+//
+//  Description:
+//  ============
+//  This function initializes most global variables.  It is called whenever the
+//  main menu is returned to, so it must not touch EEPROM.  The settings are
+//  loaded once at start-up by Config_loadSetup().
 //
 //******************************************************************************
 void Config_initialize(void)
 {
-  calStartCal = false;
-  dataClear = false;
   dataTestNumber = 0;
   keyClear = false;
-  keyCount = MENU_MEASURE;
+  keyCount = MENU_TABLE[MENU_MAIN].keyMin;
   keyCountNew = false;
-  keyEnterEscape = false;
-  keyMax = MENU_ENTER_SETUP;
-  keyMin = MENU_MEASURE;
+  keyMax = MENU_TABLE[MENU_MAIN].keyMax;
+  keyMin = MENU_TABLE[MENU_MAIN].keyMin;
   keyNewDetection = false;
   keySet = false;
-  menuInitSubmenu = false;
   menuLocationNum = 0;
-  menuShowSubmenu = false;
+  menuState = MENU_STATE_BROWSE;
+  shotSettled = false;
   showTest = false;
   showTime = true;
   showTitle = true;
-  submenuSetDensity = false;
-  submenuSetMohs = false;
-  submenuSetWeight = false;
   testClearT = false;
-  testDone = false;
-  testError = false;
-  testOk = false;
   testShowT = false;
+  testState = TEST_STATE_SHOOT;
   timeSetClock = false;
   timeUpdate = false;
-
-  Config_loadSetup();
 }
 
 
@@ -139,38 +239,86 @@ void Config_initialize(void)
 void Config_loadSetup(void)
 {
   eepromMemPtr = EEPROM_POWER;
-  submenuPower = Peripheral_readEEPROM();
-
-  eepromMemPtr = EEPROM_DENSITY;
-  submenuDensity = Peripheral_readEEPROM();
-
-  eepromMemPtr = EEPROM_WEIGHT;
-  submenuWeight = Peripheral_readEEPROM();
+  Peripheral_readEEPROMBlock((byte *) &settings, SETTINGS_SIZE);
+  if ((settings.units < SUBMENU_UNITS_MPA) || (settings.units > SUBMENU_UNITS_PSI))
+  {
+    settings.units = SUBMENU_UNITS_PSI;
+    eepromMemPtr = EEPROM_UNITS;
+    Peripheral_writeEEPROM(settings.units);
+  }
 
-  eepromMemPtr = EEPROM_MOHS;
-  submenuMohs = Peripheral_readEEPROM();
+  eepromMemPtr = EEPROM_TESTS;
+  testSetCount = Peripheral_readEEPROM();
 
-  eepromMemPtr = EEPROM_UNITS;
-  submenuUnits = Peripheral_readEEPROM();
-  if ((submenuUnits < SUBMENU_UNITS_MPA) || (submenuUnits > SUBMENU_UNITS_PSI))
+  eepromMemPtr = EEPROM_UPLOADED;
+  testUploaded = Peripheral_readEEPROM();
+  if (testUploaded > testSetCount)
   {
-    submenuUnits = SUBMENU_UNITS_PSI;
-    Peripheral_writeEEPROM(submenuUnits);
+    testUploaded = 0;
   }
 
-  eepromMemPtr = EEPROM_AGG_SIZE;
-  submenuAggSize = Peripheral_readEEPROM();
+  Config_updateScaling(&settings);
+#ifdef DISPLAY_TABLE
+  Display_checkTable();
+#endif
+}
+
 
-  eepromMemPtr = EEPROM_ZERO;
-  adcZero = Peripheral_readEEPROM();
+//******************************************************************************
+//
+//  Function: Config_loadStatistics()
+//
+//  Description:
+//  ============
+//  This function reads the statistics block of the passed group (power
+//  setting - SUBMENU_POWER_STD) and returns true if it passes its check.
+//
+//******************************************************************************
+#inline
+short int Config_loadStatistics(byte group)
+{
+  eepromMemPtr = EEPROM_STATS + group * STATS_SIZE;
+  Peripheral_readEEPROMBlock((byte *) &statistics, STATS_SIZE);
+  return (statistics.check == Config_checkStatistics());
+}
 
-  eepromMemPtr = EEPROM_FULL_SCALE;
-  adcFullScale = Peripheral_readEEPROM();
 
-  eepromMemPtr = EEPROM_TESTS;
-  testSetCount = Peripheral_readEEPROM();
-  
-  Peripheral_scaleADC();
+//******************************************************************************
+//
+//  Function: Config_rebuildStatistics()
+//
+//  Description:
+//  ============
+//  This function rebuilds every statistics block from the stored tests.  It is
+//  used when the tests are cleared or the blocks don't agree with the tests.
+//  The tests are read once, all the blocks are added up in RAM and each one
+//  is written once.
+//
+//******************************************************************************
+void Config_rebuildStatistics(void)
+{
+  byte              group;
+  Statistics        groups[STATS_GROUPS];
+  byte              record[TEST_SET_SIZE];
+  byte              test;
+
+  LCD_setCursorPosition(2, 1);
+  LCD_showLabel(LABEL_PLEASE_WAIT);
+  memset(groups, 0, sizeof(groups));
+  for (test = 1 ; test <= testSetCount ; test++)
+  {
+    Peripheral_readRecord(test, record);
+    group = record[RECORD_POWER] - SUBMENU_POWER_STD;
+    if (group < STATS_GROUPS)
+    {
+      Config_addStrength(&groups[group], Display_calculateStrength(record));
+    }
+  }
+  for (group = 0 ; group < STATS_GROUPS ; group++)
+  {
+    memcpy(&statistics, &groups[group], STATS_SIZE);
+    Config_saveStatistics(group);
+  }
 }
 
 
@@ -185,23 +333,71 @@ void Config_loadSetup(void)
 //******************************************************************************
 void Config_saveSetup(void)
 {
+  // The SETTING_* values index the settings in EEPROM order
   eepromMemPtr = EEPROM_POWER;
-  Peripheral_writeEEPROM(submenuPower);
+  Peripheral_writeEEPROMBlock((byte *) &settings, SETTING_COUNT);
+}
 
-  eepromMemPtr = EEPROM_DENSITY;
-  Peripheral_writeEEPROM(submenuDensity);
 
-  eepromMemPtr = EEPROM_WEIGHT;
-  Peripheral_writeEEPROM(submenuWeight);
+//******************************************************************************
+//
+//  Function: Config_saveSettings()
+//
+//  Description:
+//  ============
+//  This function copies the values chosen in the Set Settings menu to the
+//  submenu settings and saves them.  Light density has no MOH setting and
+//  standard density has no weight setting, so those are set to their first
+//  value.  High performance has neither, so both are left alone.
+//
+//******************************************************************************
+void Config_saveSettings(void)
+{
+  settings.power = settingValue[SETTING_POWER];
+  settings.density = settingValue[SETTING_DENSITY];
+  settings.weight = settingValue[SETTING_WEIGHT];
+  settings.mohs = settingValue[SETTING_MOHS];
+  settings.units = settingValue[SETTING_UNITS];
+  settings.aggSize = settingValue[SETTING_AGG_SIZE];
+  if (settings.power != SUBMENU_POWER_HIGH)
+  {
+    if (settings.density == SUBMENU_DENSITY_STD)
+    {
+      settings.weight = SUBMENU_WEIGHT_HIGH;
+    }
+    else
+    {
+      settings.mohs = SUBMENU_MOH_3;
+    }
+  }
+  if (settings.aggSize == SUBMENU_AGG_SIZE_MED)
+  {
+    settings.mohs = SUBMENU_MOH_3;
+  }
 
-  eepromMemPtr = EEPROM_MOHS;
-  Peripheral_writeEEPROM(submenuMohs);
+  Config_saveSetup();
+  Config_updateScaling(&settings);
+#ifdef DISPLAY_TABLE
+  Display_checkTable();
+#endif
+}
 
-  eepromMemPtr = EEPROM_UNITS;
-  Peripheral_writeEEPROM(submenuUnits);
 
-  eepromMemPtr = EEPROM_AGG_SIZE;
-  Peripheral_writeEEPROM(submenuAggSize);
+//******************************************************************************
+//
+//  Function: Config_saveStatistics()
+//
+//  Description:
+//  ============
+//  This function writes the statistics block of the passed group with its
+//  check byte.
+//
+//******************************************************************************
+void Config_saveStatistics(byte group)
+{
+  statistics.check = Config_checkStatistics();
+  eepromMemPtr = EEPROM_STATS + group * STATS_SIZE;
+  Peripheral_writeEEPROMBlock((byte *) &statistics, STATS_SIZE);
 }
 
 
@@ -211,292 +407,593 @@ void Config_saveSetup(void)
 //
 //  Description:
 //  ============
-//  This function handles the Set Settings menu.  When variables are set for
-//  the next menu following a press of the enter key, keyCount must be saved
-//  to the appropriate submenu* variable prior to doing anything else.
+//  This function handles the Set Settings menu.  The values are edited in
+//  settingValue[] and only copied to the submenu settings once the last one
+//  is set, so escaping leaves the settings unchanged.  settingState steps
+//  through SETTING_TABLE; when the enter key is pressed, keyCount must be
+//  saved to settingValue[] prior to doing anything else.
 //
 //******************************************************************************
 void Config_setSettings(void)
 {
-  if (menuInitSubmenu)
-  {
-    keyCount = submenuPower;
-    keyMax = SUBMENU_POWER_HIGH;
-    keyMin = SUBMENU_POWER_STD;
+  if (menuState == MENU_STATE_ENTER)
+  {
+    settingValue[SETTING_POWER] = settings.power;
+    settingValue[SETTING_DENSITY] = settings.density;
+    settingValue[SETTING_WEIGHT] = settings.weight;
+    settingValue[SETTING_MOHS] = settings.mohs;
+    settingValue[SETTING_UNITS] = settings.units;
+    settingValue[SETTING_AGG_SIZE] = settings.aggSize;
+    settingState = SETTING_POWER;
+    keyCount = settings.power;
     keySet = false;
-    menuInitSubmenu = false;
-    menuShowSubmenu = true;
-    submenuSetPower = true;
+    menuState = MENU_STATE_ACTIVE;
   }
 
   if (keySet)
   {
     keySet = false;
-    if (submenuSetPower)     
-    {
-      submenuPower = keyCount;                    // This line must be first.
-      submenuSetPower = false;
-      if (submenuPower < SUBMENU_POWER_HIGH)
-      {
-        keyCount = submenuDensity;
-        keyMax = SUBMENU_DENSITY_LIGHT;
-        keyMin = SUBMENU_DENSITY_STD;
-        submenuSetDensity = true;
-      }
-      else
-      {
-        keyCount = submenuUnits;
-        keyMax = SUBMENU_UNITS_PSI;
-        keyMin = SUBMENU_UNITS_MPA;
-        submenuSetUnits = true;
-      }
-    }
-    else if (submenuSetDensity)
-    {
-      submenuDensity = keyCount;                  // This line must be first.
-      submenuSetDensity = false;
-      if (submenuDensity == SUBMENU_DENSITY_STD)
-      {
-        keyCount = submenuMohs;
-        keyMax = SUBMENU_MOH_7;
-        keyMin = SUBMENU_MOH_3;
-        submenuSetMohs = true;
-      }
-      else
-      {
-        keyCount = submenuWeight;
-        keyMax = SUBMENU_WEIGHT_LOW;
-        keyMin = SUBMENU_WEIGHT_HIGH;
-        submenuSetWeight = true;
-      }
-    }
-    else if (submenuSetWeight)
-    {
-      submenuWeight = keyCount;                   // This line must be first.
-      keyCount = submenuUnits;
-      keyMax = SUBMENU_UNITS_PSI;
-      keyMin = SUBMENU_UNITS_MPA;
-      submenuMohs = SUBMENU_MOH_3;
-      submenuSetUnits = true;
-      submenuSetWeight = false;
-    }
-    else if (submenuSetMohs)
+    settingValue[settingState] = keyCount;        // This line must be first.
+    if (keyCount == SETTING_TABLE[settingState].branchValue)
     {
-      submenuMohs = keyCount;                     // This line must be first.
-      keyCount = submenuUnits;
-      keyMax = SUBMENU_UNITS_PSI;
-      keyMin = SUBMENU_UNITS_MPA;
-      submenuSetMohs = false;
-      submenuSetUnits = true;
-      submenuWeight = SUBMENU_WEIGHT_HIGH;
+      settingState = SETTING_TABLE[settingState].branchNext;
     }
-    else if (submenuSetUnits)
+    else
     {
-      submenuUnits = keycount;                    // This line must be first.
-      keyCount = submenuAggSize;
-      keyMax = SUBMENU_AGG_SIZE_LARGE;
-      keyMin = SUBMENU_AGG_SIZE_MED;
-      submenuSetAggSize = true;
-      submenuSetUnits = false;
+      settingState = SETTING_TABLE[settingState].next;
     }
-    else if (submenuSetAggSize)
+
+    if (settingState == SETTING_COUNT)
     {
-      submenuAggSize = keyCount;                  // This line must be first.
+      Config_saveSettings();
       keyClear = true;
-      submenuSetAggSize = false;
-      if (submenuAggSize == SUBMENU_AGG_SIZE_MED)
-      {
-        submenuMohs = SUBMENU_MOH_3;
-      }
-      Config_saveSetup();
+      return;
     }
+    keyCount = settingValue[settingState];
   }
 
-  LCD_clearDisplay();
-  if (submenuSetPower)
+  keyMax = SETTING_TABLE[settingState].keyMax;
+  keyMin = SETTING_TABLE[settingState].keyMin;
+  if (keyCount < keyMin)
+  {
+    keyCount = SETTING_TABLE[settingState].keyBelow;
+  }
+  else if (keyCount > SETTING_TABLE[settingState].keyLimit)
   {
-    strcpy(lcdData, "Set Power");
-    keyCount = keycount>SUBMENU_POWER_HIGH?SUBMENU_POWER_STD:keyCount;
-    keyCount = keycount<SUBMENU_POWER_STD?SUBMENU_POWER_STD:keyCount;//keycount comes in here out of bounds displays set power twice?
+    keyCount = SETTING_TABLE[settingState].keyAbove;
   }
-  else if (submenuSetDensity)
+
+  LCD_clearDisplay();
+  LCD_setCursorPosition(1, 1);
+  LCD_showLabel(SETTING_TABLE[settingState].label);
+  LCD_setCursorPosition(2, 1);
+  LCD_showLabel(SETTING_LABEL[settingValue[SETTING_UNITS] - SUBMENU_UNITS_MPA][keyCount]);
+}
+
+
+//******************************************************************************
+//
+//  Function: Config_updateScaling()
+//
+//  Description:
+//  ============
+//  This function computes the constants in the passed settings that only change
+//  with the calibration or the submenu settings, so the display routines don't
+//  have to divide.
+//
+//******************************************************************************
+void Config_updateScaling(Settings *s)
+{
+  s->scale = Display_calculateScale(s->zero, s->fullScale);
+  if (s->aggSize == SUBMENU_AGG_SIZE_MED)
   {
-    strcpy(lcdData, "Set Density");
-    keyCount = keycount>SUBMENU_DENSITY_LIGHT?SUBMENU_DENSITY_STD:keyCount;
-    keyCount = keycount<SUBMENU_DENSITY_STD?SUBMENU_DENSITY_STD:keyCount;    
+    s->aggSizeLimit = AGG_SIZE_LIMIT_1_MPA / s->scale;
   }
-  else if (submenuSetWeight)
+  else if (s->aggSize == SUBMENU_AGG_SIZE_SMALL)
   {
-    strcpy(lcdData, "Set Weight");
-    keyCount = keycount>SUBMENU_WEIGHT_SUPER_LOW?SUBMENU_WEIGHT_MED:keyCount;
-    keyCount = keycount<SUBMENU_WEIGHT_HIGH?SUBMENU_WEIGHT_MED:keyCount;
+    s->aggSizeLimit = AGG_SIZE_LIMIT_2_MPA / s->scale;
   }
-  else if (submenuSetMohs)
+  else
   {
-    strcpy(lcdData, "Set Mohs");
-    keyCount = keycount>SUBMENU_MOH_7?SUBMENU_MOH_4:keyCount;
-    keyCount = keycount<SUBMENU_MOH_3?SUBMENU_MOH_4:keyCount;
+    s->aggSizeLimit = AGG_SIZE_LIMIT_3_MPA / s->scale;
   }
-  else if (submenuSetUnits)
+
+  if (s->units == SUBMENU_UNITS_MPA)
   {
-    strcpy(lcdData, "Set Units");
-    keyCount = keycount<SUBMENU_UNITS_MPA?SUBMENU_UNITS_MPA:keyCount;
-    keyCount = keycount>SUBMENU_UNITS_PSI?SUBMENU_UNITS_PSI:keyCount;
+    s->distanceMult = DISTANCE_MULT_METRIC;
+    s->pressureMult = PRESSURE_MULT_METRIC;
   }
   else
   {
-    strcpy(lcdData, "Set Aggr Size");
-    keyCount = keycount>SUBMENU_AGG_SIZE_LARGE?SUBMENU_AGG_SIZE_SMALL:keyCount;
-    keyCount = keycount<SUBMENU_AGG_SIZE_MED?SUBMENU_AGG_SIZE_SMALL:keyCount;
+    s->distanceMult = DISTANCE_MULT_IMPERIAL;
+    s->pressureMult = PRESSURE_MULT_IMPERIAL;
   }
-  LCD_setCursorPosition(1, 1);
-  LCD_updateDisplay();
-  Display_showSubmenuSetSettings(keyCount);
-  LCD_setCursorPosition(2, 1);
-  LCD_updateDisplay();
 }
 
 
 //******************************************************************************
-//  Display Functions
+//  Diagnostic Functions
 //******************************************************************************
 
 //******************************************************************************
 //
-//  Function: Display_checkTestData()
+//  Function: Diagnostic_addTime()
 //
 //  Description:
 //  ============
-//  This function checks the test data and reports an error when appropriate.
+//  This function adds the Timer1 ticks since "start" to the passed PERF_*
+//  counter.  When the count is full, the count and total are halved, which
+//  keeps the average, so a counter never stops taking new timings.
 //
 //******************************************************************************
-void Display_checkTestData(void)
+void Diagnostic_addTime(byte counter, long start)
 {
-  byte              error_code;
-  byte              error_count;
-  long              limit;
-  byte              temp;
+  PerfCounter       *perf;
+  long              ticks;
 
-  if (submenuAggSize == SUBMENU_AGG_SIZE_MED)
+  ticks = get_timer1() - start;
+  perf = &perfCounters[counter];
+  if (perf->count == 0xffff)
   {
-    limit = AGG_SIZE_LIMIT_1_MPA / adcScale;
+    perf->count >>= 1;
+    perf->total >>= 1;
   }
-  else if (submenuAggSize == SUBMENU_AGG_SIZE_SMALL)
+  ++perf->count;
+  perf->total += ticks;
+  if (ticks > perf->max)
   {
-    limit = AGG_SIZE_LIMIT_2_MPA / adcScale;
+    perf->max = ticks;
+  }
+}
+
+
+//******************************************************************************
+//
+//  Function: Diagnostic_clearCounters()
+//
+//  Description:
+//  ============
+//  This function starts a new measurement.
+//
+//******************************************************************************
+void Diagnostic_clearCounters(void)
+{
+  memset(perfCounters, 0, sizeof(perfCounters));
+}
+
+
+//******************************************************************************
+//
+//  Function: Diagnostic_sendCounters()
+//
+//  Description:
+//  ============
+//  This function sends PERF_COUNT and then each PerfCounter as it is in RAM:
+//  count, max and total, low byte first.
+//
+//******************************************************************************
+void Diagnostic_sendCounters(void)
+{
+  byte              i;
+  byte              *data;
+
+  Peripheral_putUART(PERF_COUNT + 48);
+  data = (byte *) perfCounters;
+  for (i = 0 ; i < sizeof(perfCounters) ; i++)
+  {
+    Peripheral_putUART(*data++ + 48);
+  }
+}
+
+
+//******************************************************************************
+//  Display Functions
+//******************************************************************************
+
+//******************************************************************************
+//
+//  Function: Display_calculateDistance()
+//
+//  Description:
+//  ============
+//  This function returns the metric distance for the passed ADC reading, zero
+//  and scaling factor (see Display_calculateScale()).
+//
+//******************************************************************************
+int32 Display_calculateDistance(signed long reading, byte zero, long scale)
+{
+  return (DISTANCE_OFFSET_METRIC + ((reading - zero) * scale));
+}
+
+
+//******************************************************************************
+//
+//  Function: Display_calculatePressure()
+//
+//  Description:
+//  ============
+//  This function returns the pressure in MPa for the passed metric distance
+//  and settings.  Like the other Display_calculate*() functions it only uses
+//  its arguments, so it gives the same result for any settings or test.
+//
+//******************************************************************************
+int32 Display_calculatePressure(int32 length, byte power, byte mohs, byte weight)
+{
+  int16             b;
+  int16             m;
+  int16             min_dist;
+  int32             y;
+  float           fltdistance;
+  float           flty;
+
+  if (power == SUBMENU_POWER_HIGH)
+  {
+     fltdistance = (float) length;
+      fltdistance /= 100.0;
+      flty = 28.0 * Display_doCalculation( fltdistance * 0.0602 );
+      y = (int32)flty; 
+      min_dist = 0;
   }
   else
   {
-    limit = AGG_SIZE_LIMIT_3_MPA / adcScale;
+    if (power == SUBMENU_POWER_STD)
+    {
+      switch (mohs){
+      case SUBMENU_MOH_3:
+         b = OFFSET_SMALL_3_MPA;
+         m = SLOPE_SMALL_3_MPA;
+         min_dist = 2800;
+         break;
+      case SUBMENU_MOH_4:
+         b = OFFSET_SMALL_4_MPA;
+         m = SLOPE_SMALL_4_MPA;
+         min_dist = 2900;
+         break;
+      case SUBMENU_MOH_5:
+         b = OFFSET_SMALL_5_MPA;
+         m = SLOPE_SMALL_5_MPA;
+         min_dist = 3300;         
+         break;
+      case SUBMENU_MOH_6:
+         b = OFFSET_SMALL_6_MPA;
+         m = SLOPE_SMALL_6_MPA;
+         min_dist = 3600;         
+         break;
+      case SUBMENU_MOH_7:
+         b = OFFSET_SMALL_7_MPA;
+         m = SLOPE_SMALL_7_MPA;
+         min_dist = 3900;         
+         break;         
+      }
+    }
+    if (power == SUBMENU_POWER_LOW)
+    {
+      switch (mohs){
+      case SUBMENU_MOH_3:
+         b = OFFSET_LARGE_3_MPA;
+         m = SLOPE_LARGE_3_MPA;
+         min_dist = 2800;
+         break;
+      case SUBMENU_MOH_4:
+         b = OFFSET_LARGE_4_MPA;
+         m = SLOPE_LARGE_4_MPA;
+         min_dist = 2900;         
+         break;
+      case SUBMENU_MOH_5:
+         b = OFFSET_LARGE_5_MPA;
+         m = SLOPE_LARGE_5_MPA;
+         min_dist = 3300;
+         break;
+      case SUBMENU_MOH_6:
+         b = OFFSET_LARGE_6_MPA;
+         m = SLOPE_LARGE_6_MPA;
+         min_dist = 3600;         
+         break;
+      case SUBMENU_MOH_7:
+         b = OFFSET_LARGE_7_MPA;
+         m = SLOPE_LARGE_7_MPA;
+         min_dist = 3900;
+         break;
+      }
+    }
+    y = (m*length/1000) - b; //scaled m up by 100
   }
 
-  error_code = 0;
-  error_count = 0;
-  temp = 0;
-  if (adcData[0] > adcData[1])
+  // Scale for low and super-low weights
+  if (weight == SUBMENU_WEIGHT_LOW)
+  {
+    y = y * 84 / 100;
+  }
+  else if (weight == SUBMENU_WEIGHT_SUPER_LOW)
   {
-    temp = adcData[0] - adcData[1];
+    y = y * 66 / 100;
   }
-  if (temp > limit)
+  if (length < min_dist)
   {
-    error_code = 1;
-    ++error_count;
+    y = 0;
   }
+  return (y);
+}
 
-  temp = 0;
-  if (adcData[0] > adcData[2])
+
+//******************************************************************************
+//
+//  Function: Display_calculateRoot()
+//
+//  Description:
+//  ============
+//  This function returns the integer square root of the passed value.
+//
+//******************************************************************************
+long Display_calculateRoot(int32 value)
+{
+  int32             bit;
+  int32             root;
+
+  root = 0;
+  bit = 0x40000000;
+  while (bit > value)
   {
-    temp = adcData[0] - adcData[2];
+    bit >>= 2;
   }
-  if (temp > limit)
+  while (bit)
   {
-    error_code += 10;
-    ++error_count;
+    if (value >= root + bit)
+    {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
   }
+  return (root);
+}
 
-  temp = 0;
-  if (adcData[1] > adcData[0])
+
+//******************************************************************************
+//
+//  Function: Display_calculateScale()
+//
+//  Description:
+//  ============
+//  This function returns the metric ADC scaling factor for the passed
+//  calibration.
+//
+//******************************************************************************
+long Display_calculateScale(byte zero, byte fullScale)
+{
+  byte              span;
+
+  span = (fullScale - zero) - 1;
+  return (ADC_SCALE_FACTOR_METRIC / span);
+}
+
+
+//******************************************************************************
+//
+//  Function: Display_calculateStrength()
+//
+//  Description:
+//  ============
+//  This function returns the strength, in 0.1 MPa, of the passed test record:
+//  the pressure of the average shot, with the test's own settings.  It is
+//  limited to STATS_STRENGTH_MAX so the statistics can't overflow.
+//
+//******************************************************************************
+long Display_calculateStrength(byte *record)
+{
+  byte              i;
+  int32             length;
+  long              total;
+  int32             y;
+
+  total = 0;
+  for (i = 0 ; i < TEST_SHOTS ; i++)
   {
-    temp = adcData[1] - adcData[0];
+    total += record[RECORD_SHOTS + i];
   }
-  if (temp > limit)
+  length = Display_calculateDistance(total / TEST_SHOTS, record[RECORD_ZERO],
+             Display_calculateScale(record[RECORD_ZERO], record[RECORD_FULL_SCALE]));
+  y = Display_calculatePressure(length, record[RECORD_POWER], record[RECORD_MOHS], record[RECORD_WEIGHT]);
+  if (y > STATS_STRENGTH_MAX)
   {
-    error_code += 3;
-    ++error_count;
+    y = STATS_STRENGTH_MAX;
   }
+  return (y);
+}
 
-  temp = 0;
-  if (adcData[1] > adcData[2])
+
+#ifdef AUTO_ADVANCE
+//******************************************************************************
+//
+//  Function: Display_checkShot()
+//
+//  Description:
+//  ============
+//  This function returns true when adcReading is a new shot for auto advance.
+//  The reading must first move more than SHOT_TRIGGER away from the last shot,
+//  so the same pin isn't taken twice, and then stay within SHOT_SETTLE_BAND for
+//  SHOT_SETTLE_COUNT readings.  Run Test then takes the shot as if the enter
+//  key was pressed.
+//
+//******************************************************************************
+short int Display_checkShot(void)
+{
+  signed long       change;
+
+  change = adcReading - shotPrevious;
+  shotPrevious = adcReading;
+  if ((change > SHOT_SETTLE_BAND) || (change < -SHOT_SETTLE_BAND))
   {
-    temp = adcData[1] - adcData[2];
+    shotSettleCount = 0;
   }
-  if (temp > limit)
+  else if (shotSettleCount < SHOT_SETTLE_COUNT)
   {
-    error_code += 30;
-    ++error_count;
+    ++shotSettleCount;
   }
 
-  temp = 0;
-  if (adcData[2] > adcData[0])
+  if (shotLast < 0)
   {
-    temp = adcData[2] - adcData[0];
+    shotLast = adcReading;                        // The reading before the first shot
   }
-  if (temp > limit)
+  change = adcReading - shotLast;
+  if ((change > SHOT_TRIGGER) || (change < -SHOT_TRIGGER))
   {
-    error_code += 5;
-    ++error_count;
+    shotArmed = true;
   }
+  if (!shotArmed || (shotSettleCount < SHOT_SETTLE_COUNT))
+  {
+    return (false);
+  }
+  shotArmed = false;
+  shotLast = adcReading;
+  return (true);
+}
+#endif
 
-  temp = 0;
-  if (adcData[2] > adcData[1])
+
+//******************************************************************************
+//
+//  Function: Display_checkTable()
+//
+//  Description:
+//  ============
+//  This function makes sure the display table in EEPROM matches the live
+//  settings and calibration, and rebuilds it when they or TABLE_VERSION have
+//  changed.  Each entry holds the distance and pressure digits for one ADC
+//  code, so Display_showData() only has to read the entry and copy the
+//  digits.
+//
+//  NOTE: The key is invalidated before the rebuild and written after it, so a
+//        rebuild that is interrupted is redone at the next start-up.
+//
+//******************************************************************************
+void Display_checkTable(void)
+{
+  byte              code;
+  byte              i;
+  byte              page[TABLE_WRITE_SIZE];
+  short int         match;
+  signed long       reading;
+
+  eepromMemPtr = EEPROM_TABLE_KEY;
+  Peripheral_readEEPROMBlock(page, TABLE_KEY_SIZE);
+  match = (page[SETTINGS_SIZE] == TABLE_VERSION);
+  for (i = 0 ; i < SETTINGS_SIZE ; i++)
   {
-    temp = adcData[2] - adcData[1];
+    if (page[i] != ((byte *) &settings)[i])
+    {
+      match = false;
+    }
   }
-  if (temp > limit)
+
+  if (!match)
   {
-    error_code += 50;
-    ++error_count;
+    LCD_setCursorPosition(2, 1);
+    LCD_showLabel(LABEL_PLEASE_WAIT);
+
+    tableReady = false;
+    eepromMemPtr = EEPROM_TABLE_KEY;
+    Peripheral_writeEEPROM(0);
+
+    reading = adcReading;
+    code = 0;
+    i = 0;
+    do
+    {
+      // Render the entry the normal way and pack the digits
+      adcReading = code;
+      tableEntry = 0;
+      Display_showDistance(&settings);
+      Display_packDigits(3);
+      Display_showPressure(&settings);
+      Display_packDigits(4);
+      page[i++] = make8(tableEntry, 0);
+      page[i++] = make8(tableEntry, 1);
+      page[i++] = make8(tableEntry, 2);
+      page[i++] = make8(tableEntry, 3);
+      if (i == TABLE_WRITE_SIZE)
+      {
+        eepromMemPtr = EEPROM_TABLE + ((long) code << 2) - (TABLE_WRITE_SIZE - TABLE_ENTRY_SIZE);
+        Peripheral_writeEEPROMBlock(page, TABLE_WRITE_SIZE);
+        i = 0;
+      }
+    } while (++code != 0);
+    adcReading = reading;
+
+    memcpy(page, &settings, SETTINGS_SIZE);
+    page[SETTINGS_SIZE] = TABLE_VERSION;
+    eepromMemPtr = EEPROM_TABLE_KEY;
+    Peripheral_writeEEPROMBlock(page, TABLE_KEY_SIZE);
   }
+  tableReady = true;
+}
 
-  if (error_count)
+
+//******************************************************************************
+//
+//  Function: Display_packDigits()
+//
+//  Description:
+//  ============
+//  This function packs the digits in the display data, starting at the passed
+//  position and ending at the first space, into the display table entry.
+//
+//******************************************************************************
+void Display_packDigits(byte position)
+{
+  while (lcdData[position] != ' ')
+  {
+    if (lcdData[position] != '.')
+    {
+      tableEntry = (tableEntry << 4) | ((lcdData[position] - '0') & 0x0f);
+    }
+    ++position;
+  }
+}
+
+
+//******************************************************************************
+//
+//  Function: Display_checkTestData()
+//
+//  Description:
+//  ============
+//  This function checks the test data and reports an error when appropriate.
+//
+//******************************************************************************
+void Display_checkTestData(void)
+{
+  byte              shot;
+
+  shot = Display_findOutlier(settings.aggSizeLimit);
+  if (shot != TEST_SHOT_NONE)
   {
     LCD_clearDisplay();
-    strcpy(lcdData, "Error - Repeat");
     LCD_setCursorPosition(1, 1);
-    LCD_updateDisplay();
-    if (error_count > 2 || testError)
+    LCD_showLabel(LABEL_ERROR_REPEAT);
+    LCD_setCursorPosition(2, 1);
+    if (shot == TEST_SHOT_ALL || testState == TEST_STATE_RESHOOT)
     {
-      strcpy(lcdData, "Entire Test");
-      testDone = false;
+      LCD_showLabel(LABEL_ENTIRE_TEST);
       dataTestNumber = 0;
-      testError = false;
+      testState = TEST_STATE_SHOOT;
     }
     else
     {
-      if (error_code == 8 || error_code == 11)
-      {
-        strcpy(lcdData, "Test No:1");
-        dataTestNumber = 0;
-      }
-      if (error_code == 33 || error_code == 51)
-      {
-        strcpy(lcdData, "Test No:2");
-        dataTestNumber = 1;
-      }
-      if (error_code == 40 || error_code == 55)
-      {
-        strcpy(lcdData, "Test No:3");
-        dataTestNumber = 2;
-      }
-      testError = true;
+      LCD_showLabel(LABEL_TEST_NO_SHOT);
+      LCD_writeData('1' + shot);
+      dataTestNumber = shot;
+      testState = TEST_STATE_RESHOOT;
     }
-    LCD_setCursorPosition(2, 1);
-    LCD_updateDisplay();
     delay_ms(2000);
   }
   else
   {
-    testOk = true;
+    testState = TEST_STATE_OK;
   }
 }
 
@@ -531,18 +1028,88 @@ void Display_checkTestData(void)
 }
 
 
+//******************************************************************************
+//
+//  Function: Display_findOutlier()
+//
+//  Description:
+//  ============
+//  This function finds the shot that must be repeated.  The shots are sorted
+//  and the spread (highest - lowest) is compared to the passed limit.  When the
+//  spread is too large, the extreme shot furthest from the median is the
+//  outlier, as long as the remaining shots are within the limit.  Otherwise
+//  the entire test must be repeated.
+//
+//  Returns the shot number (0 to TEST_SHOTS - 1), TEST_SHOT_NONE when all of
+//  the shots are within the limit, or TEST_SHOT_ALL.
+//
+//  NOTE: For three shots this gives the same result as the old pairwise
+//        comparisons.  The one exception is when only the highest and lowest
+//        shots differ by more than the limit.  The old comparisons didn't pick
+//        a shot for that case, so the shot furthest from the median is used.
+//
+//******************************************************************************
+byte Display_findOutlier(byte limit)
+{
+  byte              high;
+  byte              i;
+  byte              j;
+  byte              low;
+  byte              median;
+  byte              order[TEST_SHOTS];
+
+  // Sort the shot numbers by ADC reading
+  for (i = 0 ; i < TEST_SHOTS ; i++)
+  {
+    j = i;
+    while (j && (adcData[order[j - 1]] > adcData[i]))
+    {
+      order[j] = order[j - 1];
+      --j;
+    }
+    order[j] = i;
+  }
+
+  low = adcData[order[0]];
+  high = adcData[order[TEST_SHOTS - 1]];
+  median = adcData[order[TEST_SHOTS / 2]];
+  if ((high - low) <= limit)
+  {
+    return (TEST_SHOT_NONE);
+  }
+
+  if ((high - median) > (median - low))
+  {
+    // The highest shot is the outlier if the rest are within the limit
+    if ((adcData[order[TEST_SHOTS - 2]] - low) <= limit)
+    {
+      return (order[TEST_SHOTS - 1]);
+    }
+  }
+  else
+  {
+    // The lowest shot is the outlier if the rest are within the limit
+    if ((high - adcData[order[1]]) <= limit)
+    {
+      return (order[0]);
+    }
+  }
+  return (TEST_SHOT_ALL);
+}
+
+
 //******************************************************************************
 //
 //  Function: Display_showData()
 //
 //  Description:
 //  ============
-//  This function copies the appropriate data to the display.
+//  This function shows the reading in adcReading, using the passed settings.
 //
 //******************************************************************************
-void Display_showData(void)
+void Display_showData(Settings *s)
 {
-  Display_showDistance();
+  Display_showDistance(s);
   if (testClearT || testShowT)
   {
     if (testShowT)
@@ -557,7 +1124,7 @@ void Display_showData(void)
       lcdData[++lcdPosition] = ' ';
       lcdData[++lcdPosition] = ' ';
     }
-    if (!testOk)
+    if (testState != TEST_STATE_OK)
     {
       lcdData[++lcdPosition] = ' ';
       lcdData[++lcdPosition] = 'N';
@@ -577,14 +1144,14 @@ void Display_showData(void)
   LCD_setCursorPosition(1, 1);
   LCD_updateDisplay();
   lcdData[lcdPosition] = 0;
-  if (testOk)
+  if (testState == TEST_STATE_OK)
   {
-    distance = DISTANCE_OFFSET_METRIC + ((adcReading - adcZero) * adcScale);    // For unknown reasons, the value of distance
+    distance = Display_calculateDistance(adcReading, s->zero, s->scale);        // For unknown reasons, the value of distance
                                                                                 // is overwritten between line 580 and here.
   }
-  Display_showPressure();
+  Display_showPressure(s);
 
-  if (submenuPower == SUBMENU_POWER_HIGH)
+  if (s->power == SUBMENU_POWER_HIGH)
   {
     lcdData[++lcdPosition] = 'H';
     lcdData[++lcdPosition] = 'P';
@@ -592,7 +1159,7 @@ void Display_showData(void)
   }
   else
   {
-    if (submenuPower == SUBMENU_POWER_STD)
+    if (s->power == SUBMENU_POWER_STD)
     {
       lcdData[++lcdPosition] = 'S';
     }
@@ -601,38 +1168,38 @@ void Display_showData(void)
       lcdData[++lcdPosition] = 'L';
     }
 
-    if (submenuDensity == SUBMENU_DENSITY_STD)
+    if (s->density == SUBMENU_DENSITY_STD)
     {
       lcdData[++lcdPosition] = 's';
-      lcdData[++lcdPosition] =(submenuMohs - 3) + '0';
+      lcdData[++lcdPosition] =(s->mohs - 3) + '0';
     }
     else
     {
       lcdData[++lcdPosition] = 'l';
-      if (submenuWeight == SUBMENU_WEIGHT_HIGH)
+      if (s->weight == SUBMENU_WEIGHT_HIGH)
       {
         lcdData[++lcdPosition] = 'h';
       }
-      if (submenuWeight == SUBMENU_WEIGHT_MED)
+      if (s->weight == SUBMENU_WEIGHT_MED)
       {
         lcdData[++lcdPosition] = 'm';
       }
-      if (submenuWeight == SUBMENU_WEIGHT_LOW)
+      if (s->weight == SUBMENU_WEIGHT_LOW)
       {
         lcdData[++lcdPosition] = 'l';
       }
     }
   }
   
-  if (submenuAggSize == SUBMENU_AGG_SIZE_MED)
+  if (s->aggSize == SUBMENU_AGG_SIZE_MED)
   {
     lcdData[++lcdPosition] = 'M';
   }
-  else if (submenuAggSize == SUBMENU_AGG_SIZE_SMALL)
+  else if (s->aggSize == SUBMENU_AGG_SIZE_SMALL)
   {
     lcdData[++lcdPosition] = 'S';
   }
-  else if (submenuAggSize == SUBMENU_AGG_SIZE_LARGE)
+  else if (s->aggSize == SUBMENU_AGG_SIZE_LARGE)
   {
     lcdData[++lcdPosition] = 'L';
   }
@@ -674,40 +1241,35 @@ void Display_showDecimal(int data)
 //  This function displays the distance data.
 //
 //******************************************************************************
-void Display_showDistance(void)
+void Display_showDistance(Settings *s)
 {
-  byte              digit;
-  long              divisor;
-  byte              i;
-  long              temp;
+  byte              point;
 
-  distance = DISTANCE_OFFSET_METRIC + ((adcReading - adcZero) * adcScale);
-  if (submenuUnits == SUBMENU_UNITS_MPA)
+  if (s->units == SUBMENU_UNITS_MPA)
   {
     // Show metric units
     strcpy(lcdData, "mm:");
-    temp = distance * 10;
+    point = 2;
   }
   else
   {
     // Show imperial units
     strcpy(lcdData, "in:");
-    temp = distance * DISTANCE_CONV_FACTOR;
+    point = 1;
   }
   lcdPosition = 3;
-  divisor = 10000;
-  for (i = 0 ; i  < 3 ; i++)
+#ifdef DISPLAY_TABLE
+  if (tableReady && (s == &settings))
   {
-    digit = temp / divisor;
-    temp -= digit * divisor;
-    divisor /= 10;
-    if (((submenuUnits == SUBMENU_UNITS_MPA) && (i == 2)) ||
-        ((submenuUnits == SUBMENU_UNITS_PSI) && (i == 1)))
-    {
-      lcdData[lcdPosition++] = '.';
-    }
-    lcdData[lcdPosition] = digit + '0';
-    ++lcdPosition;
+    eepromMemPtr = EEPROM_TABLE + ((long) make8(adcReading, 0) << 2);
+    Peripheral_readEEPROMBlock((byte *) &tableEntry, TABLE_ENTRY_SIZE);
+    Display_showTableDigits(3, point);
+  }
+  else
+#endif
+  {
+    distance = Display_calculateDistance(adcReading, s->zero, s->scale);
+    Display_showNumber((distance * s->distanceMult) >> DISTANCE_SHIFT, 3, point);
   }
   lcdData[lcdPosition] = ' ';
 }
@@ -724,64 +1286,60 @@ void Display_showDistance(void)
 //******************************************************************************
 void Display_showMenuDownloadTests()
 {
+   byte              i;
 
-   if (menuInitSubmenu)
+   if (menuState == MENU_STATE_ENTER)
    {
+      Peripheral_flushData();
+      downloadState = DOWNLOAD_STATE_CONNECT;
       keySet = false;
-      menuInitSubmenu = false;
-      menuShowSubmenu = true;
-      strcpy(lcdData, "Connect PC");
+      menuState = MENU_STATE_ACTIVE;
       LCD_setCursorPosition(2, 1);
-      LCD_updateDisplay();
+      LCD_showLabel(LABEL_CONNECT_PC);
+      while (kbhit())
+      {
+         getc();                                  // Discard anything received before
+      }
    }
 
-   if (keySet && !keyEnterEscape)
+   if (keySet)
    {
       keySet = false;
-      if (dataClear)
+      if (downloadState == DOWNLOAD_STATE_CONNECT)
       {
-         testSetCount = 0;
-         eepromMemPtr = EEPROM_TESTS;
-         Peripheral_writeEEPROM(testSetCount);
-         keyClear = true;
+         // Only the tests the PC has not acknowledged are sent
+         Peripheral_sendRecords(testUploaded + 1, testSetCount, SEND_MODE_DOWNLOAD);
+         Peripheral_flushUART();
+
+         for (i = 0 ; (i < DOWNLOAD_ACK_WAIT) && (testUploaded < testSetCount) ; i++)
+         {
+            delay_ms(1);
+            Peripheral_readUploadAck();
+         }
+
+         LCD_clearDisplay();
+         LCD_setCursorPosition(1, 1);
+         LCD_showLabel(LABEL_CLEAR_TESTS);
+         LCD_setCursorPosition(2, 1);
+         LCD_showLabel(LABEL_ENTER_YES_ESC_NO);
+         downloadState = DOWNLOAD_STATE_CLEAR;
       }
       else
       {
-      putc(testSetCount + 48);
-  //eepromMemPtr = testSetCount * TEST_SET_SIZE;  // Since this line that doesn't work, it has been replaced with a loop.
-      int16  totalmemory = 0;
-      for (int16 i = 0; i < testSetCount ; i++)
-      {
-         totalmemory += TEST_SET_SIZE;
-      }      
-      
-      for (eepromMemPtr = 0 ; eepromMemPtr < totalmemory/*testSetCount * TEST_SET_SIZE*/ ; ++eepromMemPtr)
-      {
-        putc(Peripheral_readEEPROM() + 48);
-      }
-      LCD_clearDisplay();
-      strcpy(lcdData, "Clear Tests?");
-      LCD_setCursorPosition(1, 1);
-      LCD_updateDisplay();
-      strcpy(lcdData, "Enter-YES ESC-NO");
-      LCD_setCursorPosition(2, 1);
-      LCD_updateDisplay();
-      keyEnterEscape = true;
-      }
-   }
-
-   if (keyEnterEscape && keySet)
-   {
-    dataClear = true;
-    keyClear = true;
-    testSetCount = 0;
-    eepromMemPtr = EEPROM_TESTS;
-    Peripheral_writeEEPROM(testSetCount);
-    keyEnterEscape = false;
+         testSetCount = 0;
+         eepromMemPtr = EEPROM_TESTS;
+         Peripheral_writeEEPROM(testSetCount);
+         testUploaded = 0;
+         eepromMemPtr = EEPROM_UPLOADED;
+         Peripheral_writeEEPROM(testUploaded);
+         Config_rebuildStatistics();
+         keyClear = true;
+      }
    }
-   else if (keyEnterEscape && keyClear)
-   {      
-    keyEnterEscape = false;
+   else if (downloadState == DOWNLOAD_STATE_CONNECT)
+   {
+      Peripheral_readCommand();
+      keyNewDetection = true;
    }
 }
 
@@ -797,54 +1355,25 @@ void Display_showMenuDownloadTests()
 //******************************************************************************
 void Display_showMenuEnterSetup(void)
 {
-  if (menuInitSubmenu)
+  if (menuState == MENU_STATE_ENTER)
   {
-    keyCount = 1;
-    keyMax = 4;
-    keyMin = 1;
+    keyCount = MENU_TABLE[MENU_ENTER_SETUP].keyMin;
+    keyMax = MENU_TABLE[MENU_ENTER_SETUP].keyMax;
+    keyMin = MENU_TABLE[MENU_ENTER_SETUP].keyMin;
     keySet = false;
-    menuInitSubmenu = false;
-    menuShowSubmenu = true;
+    menuState = MENU_STATE_ACTIVE;
   }
 
   if (keySet)
   {
     keySet = false;
-    menuInitSubmenu = true;
-    switch(keyCount){      
-    case SUBMENU_SET_SHOW:
-      menuLocationNum = MENU_SHOW_SETTINGS;
-      break;
-    case SUBMENU_SET_SET:
-      menuLocationNum = MENU_SET_SETTINGS;
-      break;
-    case SUBMENU_SET_CLOCK:
-      menuLocationNum = MENU_SET_CLOCK;
-      break;
-    case SUBMENU_SET_CALIBRATE:
-      menuLocationNum = MENU_CALIBRATE;
-      break;
-    }
+    menuState = MENU_STATE_ENTER;
+    menuLocationNum = Config_getMenuChild(MENU_ENTER_SETUP);
   }
-  
-  LCD_clearDisplay();
-      switch(keyCount){      
-    case SUBMENU_SET_SHOW:
-      strcpy(lcdData, "Show Settings");
-      break;
-    case SUBMENU_SET_SET:
-      strcpy(lcdData, "Set Settings");
-      break;
-    case SUBMENU_SET_CLOCK:
-      strcpy(lcdData, "Set Clock");
-      break;
-    case SUBMENU_SET_CALIBRATE:
-      strcpy(lcdData, "Calibrate");
-      break;
-    }
 
+  LCD_clearDisplay();
   LCD_setCursorPosition(1, 1);
-  LCD_updateDisplay();
+  LCD_showLabel(MENU_TABLE[Config_getMenuChild(MENU_ENTER_SETUP)].label);
 }
 
 
@@ -859,14 +1388,13 @@ void Display_showMenuEnterSetup(void)
 //******************************************************************************
 void Display_showMenuMeasure(void)
 {
-  if (menuInitSubmenu)
+  if (menuState == MENU_STATE_ENTER)
   {
-    menuInitSubmenu = false;
-    menuShowSubmenu = true;
+    menuState = MENU_STATE_ACTIVE;
     LCD_clearDisplay();
   }
   Peripheral_getADC();
-  Display_showData();
+  Display_showData(&settings);
   keyNewDetection = true;
 }
 
@@ -885,13 +1413,12 @@ void Display_showMenuRunTest(void)
   byte              i;
   static long       total;
 
-  if (menuInitSubmenu)
+  if (menuState == MENU_STATE_ENTER)
   {
     if (testSetCount == TEST_MAX_SETS)
     {
-      strcpy(lcdData, "Memory Full");
       LCD_setCursorPosition(2, 1);
-      LCD_updateDisplay();
+      LCD_showLabel(LABEL_MEMORY_FULL);
       delay_ms(2000);
       keyClear = true;
     }
@@ -899,58 +1426,61 @@ void Display_showMenuRunTest(void)
     {
       dataTestNumber = 0;
       keySet = false;
-      menuInitSubmenu = false;
-      menuShowSubmenu = true;
+      menuState = MENU_STATE_ACTIVE;
+#ifdef AUTO_ADVANCE
+      shotArmed = false;
+      shotLast = -1;
+      shotSettleCount = 0;
+#endif
       testClearT = true;
-      testDone = false;
-      testError = false;
-      testOk = false;
+      testState = TEST_STATE_SHOOT;
     }
   }
 
-  if (keySet)
+  if (keySet || shotSettled)
   {
     keySet = false;
+    shotSettled = false;
     LCD_clearDisplay();
 
-    if (testOk)
+    if (testState == TEST_STATE_OK)
     {
       // Update the time and store the data set
       Peripheral_readRTC();
       Peripheral_saveData();
       keyClear = true;
     }
-
-    if (!testDone)
+    else
     {
-      ++dataTestNumber;
-      if (dataTestNumber == 3)
+      if (testState == TEST_STATE_SHOOT)
       {
-        testDone = true;
+        ++dataTestNumber;
+      }
+      if (dataTestNumber == TEST_SHOTS || testState == TEST_STATE_RESHOOT)
+      {
+        Display_checkTestData();
       }
-    }
-
-    if (testDone)
-    {
-      Display_checkTestData();
     }
   }
 
-  if (!testOk)
+  if (testState != TEST_STATE_OK)
   {
     Peripheral_getADC();
     adcData[dataTestNumber] = adcReading;
+#ifdef AUTO_ADVANCE
+    shotSettled = Display_checkShot();
+#endif
   }
   else
   {
     total = 0;
-    for (i = 0 ; i < 3 ; i++)
+    for (i = 0 ; i < TEST_SHOTS ; i++)
     {
       total += adcData[i];
     }
-    adcReading = total / 3;
+    adcReading = total / TEST_SHOTS;
   }
-  Display_showData();
+  Display_showData(&settings);
   keyNewDetection = true;
 }
 
@@ -966,45 +1496,73 @@ void Display_showMenuRunTest(void)
 //******************************************************************************
 void Display_showMenuShowTests(void)
 {
+  byte              count;
+  static byte       first;
+  byte              i;
+  byte              record[TEST_SET_SIZE];
   static long       total;
 
-  if (menuInitSubmenu)
+  if (menuState == MENU_STATE_ENTER)
   {
+    Peripheral_flushData();
     testShowT = true;
     keyMax = testSetCount;
     keyMin = 1;
     keySet = false;
-    menuInitSubmenu = false;
-    menuShowSubmenu = true;
+    menuState = MENU_STATE_ACTIVE;
 
     LCD_clearDisplay();
-    strcpy(lcdData, "Test No.");
     LCD_setCursorPosition(1, 1);
-    LCD_updateDisplay();
+    LCD_showLabel(LABEL_GO_TO_DATE);
 
     dataTestNumber = 0;
+    first = 1;
     keyCount = 1;
+    keyCountNew = true;                           // Show the first day
+    showCacheFirst = 0;
+    showDate = true;
     total = 0;
   }
 
+  if (keySet && showDate)
+  {
+    // Browse the tests from the first one of the chosen day
+    keySet = false;
+    showDate = false;
+    LCD_clearDisplay();
+    LCD_setCursorPosition(1, 1);
+    LCD_showLabel(LABEL_TEST_NO);
+  }
+
   if (keySet)
   {
     keySet = false;
-    showTest = true;
-    if (dataTestNumber < 3)
+    if (!showTest)
+    {
+      // Only the test being viewed is read in full
+      showTest = true;
+      Peripheral_readRecord(keyCount, record);
+      memcpy(&testSettings, &record[RECORD_POWER], SETTINGS_SIZE);  // Not the live settings
+      for (i = 0 ; i < TEST_SHOTS ; i++)
+      {
+        adcData[i] = record[RECORD_SHOTS + i];
+      }
+      Config_updateScaling(&testSettings);
+    }
+    if (dataTestNumber < TEST_SHOTS)
     {
       adcReading = adcData[dataTestNumber];
       total += adcReading;
     }
-    if (dataTestNumber == 3)
+    if (dataTestNumber == TEST_SHOTS)
     {
-      adcReading = total / 3;
-      testOk = true;
+      adcReading = total / TEST_SHOTS;
+      testState = TEST_STATE_OK;
     }
-    if (dataTestNumber < 4)
+    if (dataTestNumber <= TEST_SHOTS)
     {
       LCD_clearDisplay();
-      Display_showData();
+      Display_showData(&testSettings);
     }
     else
     {
@@ -1012,6 +1570,36 @@ void Display_showMenuShowTests(void)
     }
     ++dataTestNumber;
   }
+  else if (showDate && keyCountNew)
+  {
+    // The up and down keys jump to the first test of the next or previous
+    // day, which is found by a binary search on the packed times
+    keyCountNew = false;
+    if (keyCount == first + 1)
+    {
+      Peripheral_readRecordTimes(first, 1, record);
+      keyCount = Peripheral_findRecord((Peripheral_packTime(record) | STAMP_TIME_MASK) + 1);
+      if (keyCount > testSetCount)
+      {
+        keyCount = 1;
+      }
+    }
+    else
+    {
+      Peripheral_readRecordTimes(keyCount, 1, record);
+      keyCount = Peripheral_findRecord(Peripheral_packTime(record) & ~(int32) STAMP_TIME_MASK);
+    }
+    first = keyCount;
+    Peripheral_readRecordTimes(first, 1, record);
+    timeRTCData[1] = record[RECORD_MINUTES];
+    timeRTCData[2] = record[RECORD_HOURS];
+    timeRTCData[4] = record[RECORD_DAY];
+    timeRTCData[5] = record[RECORD_MONTH];
+    timeRTCData[6] = record[RECORD_YEAR];
+    Display_showTime();
+    LCD_setCursorPosition(2, 1);
+    LCD_updateDisplay();
+  }
   else if (!showTest)
   {
     lcdPosition = 0;
@@ -1019,154 +1607,95 @@ void Display_showMenuShowTests(void)
     lcdData[++lcdPosition] = 0;
     LCD_setCursorPosition(1, 9);
     LCD_updateDisplay();
-    eepromMemPtr = (keyCount - 1) * TEST_SET_SIZE;
-    timeRTCData[1] = Peripheral_readEEPROM();     // EEPROM Data Offset  0
-    ++eepromMemPtr;
-    timeRTCData[2] = Peripheral_readEEPROM();     // EEPROM Data Offset  1
-    ++eepromMemPtr;
-    timeRTCData[4] = Peripheral_readEEPROM();     // EEPROM Data Offset  2
-    ++eepromMemPtr;
-    timeRTCData[5] = Peripheral_readEEPROM();     // EEPROM Data Offset  3
-    ++eepromMemPtr;
-    timeRTCData[6] = Peripheral_readEEPROM();     // EEPROM Data Offset  4
-    ++eepromMemPtr;
-    submenuPower = Peripheral_readEEPROM();       // EEPROM Data Offset  5
-    ++eepromMemPtr;
-    submenuDensity = Peripheral_readEEPROM();     // EEPROM Data Offset  6
-    ++eepromMemPtr;
-    submenuWeight = Peripheral_readEEPROM();      // EEPROM Data Offset  7
-    ++eepromMemPtr;
-    submenuMohs = Peripheral_readEEPROM();        // EEPROM Data Offset  8
-    ++eepromMemPtr;
-    submenuUnits = Peripheral_readEEPROM();       // EEPROM Data Offset  9
-    ++eepromMemPtr;
-    submenuAggSize = Peripheral_readEEPROM();     // EEPROM Data Offset 10
-    ++eepromMemPtr;
-    adcZero = Peripheral_readEEPROM();            // EEPROM Data Offset 11
-    ++eepromMemPtr;
-    adcFullScale = Peripheral_readEEPROM();       // EEPROM Data Offset 12
-    ++eepromMemPtr;
-    adcData[0] = Peripheral_readEEPROM();         // EEPROM Data Offset 13
-    ++eepromMemPtr;
-    adcData[1] = Peripheral_readEEPROM();         // EEPROM Data Offset 14
-    ++eepromMemPtr;
-    adcData[2] = Peripheral_readEEPROM();         // EEPROM Data Offset 15
+
+    // Scrolling only needs the time, which comes from the cache.  On a miss,
+    // the times of the tests around keyCount are read in one sequential read.
+    i = keyCount - showCacheFirst;
+    if (!showCacheFirst || (keyCount < showCacheFirst) || (i >= SHOW_CACHE_SIZE))
+    {
+      showCacheFirst = 1;
+      if (keyCount > SHOW_CACHE_SIZE / 2)
+      {
+        showCacheFirst = keyCount - SHOW_CACHE_SIZE / 2;
+      }
+      count = testSetCount - showCacheFirst + 1;
+      if (count > SHOW_CACHE_SIZE)
+      {
+        count = SHOW_CACHE_SIZE;
+      }
+      Peripheral_readRecordTimes(showCacheFirst, count, (byte *) showCache);
+      i = keyCount - showCacheFirst;
+    }
+    timeRTCData[1] = showCache[i][RECORD_MINUTES];
+    timeRTCData[2] = showCache[i][RECORD_HOURS];
+    timeRTCData[4] = showCache[i][RECORD_DAY];
+    timeRTCData[5] = showCache[i][RECORD_MONTH];
+    timeRTCData[6] = showCache[i][RECORD_YEAR];
     Display_showTime();
     LCD_setCursorPosition(2, 1);
     LCD_updateDisplay();
-    Peripheral_scaleADC();
   }
 }
 
 
 //******************************************************************************
 //
-//  Function: Display_showPressure()
+//  Function: Display_showNumber()
 //
 //  Description:
 //  ============
-//  This function displays the pressure data as MPa or PSI.  Do all the
-//  calculations in MPa and then convert to PSI if necessary.
+//  This function copies the last "digits" decimal digits of the passed value
+//  to the display, starting at lcdPosition.  A decimal point is put in front of
+//  digit number "point"; pass point >= digits for no decimal point.  The digits
+//  are found by subtraction so that no division is needed.
 //
 //******************************************************************************
-void Display_showPressure(void)
+void Display_showNumber(int32 value, byte digits, byte point)
 {
-  int16             b;
-  int16             m;
-  int16             min_dist;
-  int32             y;
-  float           fltdistance;
-  float           flty;
-  int32           td;
+  byte              digit;
+  byte              i;
+  int32             power;
 
-  if (submenuPower == SUBMENU_POWER_HIGH)
-  {
-     fltdistance = (float) distance;
-      fltdistance /= 100.0;
-      flty = 28.0 * Display_doCalculation( fltdistance * 0.0602 );
-      y = (int32)flty; 
-      min_dist = 0;
-  }
-  else
+  for (i = 0 ; i < digits ; i++)
   {
-    if (submenuPower == SUBMENU_POWER_STD)
+    power = DISPLAY_POWERS[DISPLAY_DIGITS - digits + i];
+    digit = 0;
+    while (value >= power)
     {
-      switch (submenuMohs){
-      case SUBMENU_MOH_3:
-         b = OFFSET_SMALL_3_MPA;
-         m = SLOPE_SMALL_3_MPA;
-         min_dist = 2800;
-         break;
-      case SUBMENU_MOH_4:
-         b = OFFSET_SMALL_4_MPA;
-         m = SLOPE_SMALL_4_MPA;
-         min_dist = 2900;
-         break;
-      case SUBMENU_MOH_5:
-         b = OFFSET_SMALL_5_MPA;
-         m = SLOPE_SMALL_5_MPA;
-         min_dist = 3300;         
-         break;
-      case SUBMENU_MOH_6:
-         b = OFFSET_SMALL_6_MPA;
-         m = SLOPE_SMALL_6_MPA;
-         min_dist = 3600;         
-         break;
-      case SUBMENU_MOH_7:
-         b = OFFSET_SMALL_7_MPA;
-         m = SLOPE_SMALL_7_MPA;
-         min_dist = 3900;         
-         break;         
-      }
+      value -= power;
+      ++digit;
     }
-    if (submenuPower == SUBMENU_POWER_LOW)
+    if (i == point)
     {
-      switch (submenuMohs){
-      case SUBMENU_MOH_3:
-         b = OFFSET_LARGE_3_MPA;
-         m = SLOPE_LARGE_3_MPA;
-         min_dist = 2800;
-         break;
-      case SUBMENU_MOH_4:
-         b = OFFSET_LARGE_4_MPA;
-         m = SLOPE_LARGE_4_MPA;
-         min_dist = 2900;         
-         break;
-      case SUBMENU_MOH_5:
-         b = OFFSET_LARGE_5_MPA;
-         m = SLOPE_LARGE_5_MPA;
-         min_dist = 3300;
-         break;
-      case SUBMENU_MOH_6:
-         b = OFFSET_LARGE_6_MPA;
-         m = SLOPE_LARGE_6_MPA;
-         min_dist = 3600;         
-         break;
-      case SUBMENU_MOH_7:
-         b = OFFSET_LARGE_7_MPA;
-         m = SLOPE_LARGE_7_MPA;
-         min_dist = 3900;
-         break;
-      }
+      lcdData[lcdPosition++] = '.';
     }
-    y = (m*distance/1000) - b; //scaled m up by 100
+    lcdData[lcdPosition++] = digit + '0';
   }
+}
 
-  // Scale for low and super-low weights
-  if (submenuWeight == SUBMENU_WEIGHT_LOW)
-  {
-    y = y * 84 / 100;
-  }
-  else if (submenuWeight == SUBMENU_WEIGHT_SUPER_LOW)
-  {
-    y = y * 66 / 100;
-  }
-  if (distance < min_dist)
+
+//******************************************************************************
+//
+//  Function: Display_showPressure()
+//
+//  Description:
+//  ============
+//  This function displays the pressure data as MPa or PSI.  Do all the
+//  calculations in MPa and then convert to PSI if necessary.
+//
+//******************************************************************************
+void Display_showPressure(Settings *s)
+{
+#ifdef DISPLAY_TABLE
+  if (tableReady && (s == &settings))
   {
-    y = 0;
+    // The digits come from the display table entry
+    Display_updateDisplayPressure(s, 0);
+    return;
   }
+#endif
 
-  Display_updateDisplayPressure(y);
+  Display_updateDisplayPressure(s, Display_calculatePressure(distance, s->power, s->mohs, s->weight));
 }
 
 
@@ -1181,67 +1710,122 @@ void Display_showPressure(void)
 //******************************************************************************
 void Display_showSubmenuCalibrate(void)
 {
-  static short int  calSetZero = false;
   static byte       temp;
 
-  if (menuInitSubmenu)
+  if (menuState == MENU_STATE_ENTER)
   {
-    calStartCal = true;
+    calState = CAL_STATE_START;
     keySet = false;
-    menuInitSubmenu = false;
+    menuState = MENU_STATE_ACTIVE;
   }
 
   if (keySet)
   {
     keySet = false;
-    if (calStartCal)
+    if (calState == CAL_STATE_START)
     {
-      calSetZero = true;
-      calStartCal = false;
+      calState = CAL_STATE_ZERO;
     }
-    else if (calSetZero)
+    else if (calState == CAL_STATE_ZERO)
     {
-      calSetZero = false;
+      calState = CAL_STATE_FULL_SCALE;
       Peripheral_getADC();
       temp = adcReading;
     }
     else
     {
-      adcZero = temp;
+      settings.zero = temp;
       Peripheral_getADC();
-      adcFullScale = adcReading;
+      settings.fullScale = adcReading;
       eepromMemPtr = EEPROM_ZERO;
-      Peripheral_writeEEPROM(adcZero);
+      Peripheral_writeEEPROM(settings.zero);
       eepromMemPtr = EEPROM_FULL_SCALE;
-      Peripheral_writeEEPROM(adcFullScale);
+      Peripheral_writeEEPROM(settings.fullScale);
+      Config_updateScaling(&settings);
+#ifdef DISPLAY_TABLE
+      Display_checkTable();
+#endif
       keyClear = true;
     }
   }
   LCD_clearDisplay();
+  LCD_setCursorPosition(1, 1);
 
-  if (calStartCal)
+  if (calState == CAL_STATE_START)
   {
-    strcpy(lcdData, "Calibrate");
+    LCD_showLabel(LABEL_CALIBRATE);
+    LCD_setCursorPosition(2, 1);
+    LCD_showLabel(LABEL_ENTER_YES_ESC_NO);
   }
-  else if (calSetZero)
+  else if (calState == CAL_STATE_ZERO)
   {
-    strcpy(lcdData, "Zero Press Enter");
+    LCD_showLabel(LABEL_ZERO_PRESS_ENTER);
   }
   else
   {
-    strcpy(lcdData, "Max Press Enter");
+    LCD_showLabel(LABEL_MAX_PRESS_ENTER);
+  }
+}
+
+//******************************************************************************
+//
+//  Function: Display_showSubmenuDiagnostics()
+//
+//  Description:
+//  ============
+//  This function shows the performance counters.  The up and down keys select
+//  the counter and the enter key clears them all.  Line 1 has the number of
+//  timings and line 2 the average and longest time, in ms.
+//
+//******************************************************************************
+void Display_showSubmenuDiagnostics(void)
+{
+  PerfCounter       *perf;
+  int32             value;
+
+  if (menuState == MENU_STATE_ENTER)
+  {
+    keyCount = MENU_TABLE[MENU_DIAGNOSTICS].keyMin;
+    keyMax = MENU_TABLE[MENU_DIAGNOSTICS].keyMax;
+    keyMin = MENU_TABLE[MENU_DIAGNOSTICS].keyMin;
+    keySet = false;
+    menuState = MENU_STATE_ACTIVE;
+  }
+
+  if (keySet)
+  {
+    keySet = false;
+    Diagnostic_clearCounters();
   }
+
+  perf = &perfCounters[keyCount];
+  LCD_clearDisplay();
   LCD_setCursorPosition(1, 1);
+  LCD_showLabel(PERF_LABEL[keyCount]);
+  strcpy(lcdData, "N:");
+  lcdPosition = 2;
+  Display_showNumber(perf->count, DISPLAY_DIGITS, DISPLAY_DIGITS);
+  lcdData[lcdPosition] = 0;
+  LCD_setCursorPosition(1, 10);
   LCD_updateDisplay();
 
-  if (calStartCal)
+  value = 0;
+  if (perf->count)
   {
-    strcpy(lcdData, "Enter-YES ESC-NO");
-    LCD_setCursorPosition(2, 1);
-    LCD_updateDisplay();
+    value = perf->total / perf->count;
   }
+  lcdData[0] = 'A';
+  lcdPosition = 1;
+  Display_showNumber(value * PERF_TICK_US / 10, DISPLAY_DIGITS, 3);
+  lcdData[lcdPosition++] = ' ';
+  lcdData[lcdPosition++] = 'M';
+  Display_showNumber((int32) perf->max * PERF_TICK_US / 10, DISPLAY_DIGITS, 3);
+  lcdData[lcdPosition] = 0;
+  LCD_setCursorPosition(2, 1);
+  LCD_updateDisplay();
 }
 
+
 //******************************************************************************
 //
 //  Function: Display_showSubmenuSetClock()
@@ -1256,12 +1840,11 @@ void Display_showSubmenuSetClock(void)
   byte              countOnes;
   byte              countTens;
 
-  if (menuInitSubmenu)
+  if (menuState == MENU_STATE_ENTER)
   {
     keyCountNew = false;
     keySet = false;
-    menuInitSubmenu = false;
-    menuShowSubmenu = true;
+    menuState = MENU_STATE_ACTIVE;
     timeSetClock = true;
     Peripheral_readRTC();
     Display_showTime();
@@ -1371,142 +1954,190 @@ void Display_showSubmenuSetClock(void)
 //
 //  Description:
 //  ============
-//  This function copies the appropriate text to the display based on the
-//   passed data.
+//  This function sends the appropriate text to the display, at the current
+//   cursor position, based on the passed data.
 //
 //******************************************************************************
 void Display_showSubmenuSetSettings(byte data)
 {
-   switch(data){
-   case SUBMENU_POWER_STD:
-      strcpy(lcdData, "Std Power");
-      break;
-   case SUBMENU_POWER_LOW:
-      strcpy(lcdData, "Low Power");
-      break;
-   case SUBMENU_POWER_HIGH:
-      strcpy(lcdData, "High Perf");
-      break;
-   case SUBMENU_DENSITY_STD:
-      strcpy(lcdData, "Std Wght ");
-      break;
-   case SUBMENU_DENSITY_LIGHT:
-      strcpy(lcdData, "Lgt Wght ");
-      break;      
-   case SUBMENU_MOH_3:
-      strcpy(lcdData, "MOH#3 ");
-      break;
-   case SUBMENU_MOH_4:
-      strcpy(lcdData, "MOH#4 ");
-      break;      
-   case SUBMENU_MOH_5:
-      strcpy(lcdData, "MOH#5 ");
-      break;      
-   case SUBMENU_MOH_6:
-      strcpy(lcdData, "MOH#6 ");
-      break;      
-   case SUBMENU_MOH_7:
-      strcpy(lcdData, "MOH#7 ");
-      break;      
-   case SUBMENU_UNITS_MPA:
-      strcpy(lcdData, "MPa");
-      break;
-   case SUBMENU_UNITS_PSI:
-      strcpy(lcdData, "PSI");
-      break;
-   case SUBMENU_AGG_SIZE_MED:
-      strcpy(lcdData, "Mrtr-M");
-      break;
-   }
+  if (data <= SUBMENU_WEIGHT_SUPER_LOW)
+  {
+    LCD_showLabel(SETTING_LABEL[settings.units - SUBMENU_UNITS_MPA][data]);
+  }
+}
+
+
+//******************************************************************************
+//
+//  Function: Display_showSubmenuShowSettings()
+//
+//  Description:
+//  ============
+//  This function sends the Show Settings submenu data to the display.
+//
+//******************************************************************************
+void Display_showSubmenuShowSettings(void)
+{
+  if (menuState == MENU_STATE_ENTER)
+  {
+    menuState = MENU_STATE_ACTIVE;
+    keySet = false;
+    LCD_clearDisplay();
+  }
+  if (keySet)
+  {
+    keyClear = true;
+  }
+  LCD_setCursorPosition(1, 1);
+  Display_showSubmenuSetSettings(settings.power);
+  LCD_setCursorPosition(1, 11);
+  Display_showSubmenuSetSettings(settings.aggSize);
+  if (settings.power != SUBMENU_POWER_HIGH)
+  {
+    LCD_setCursorPosition(2, 1);
+    Display_showSubmenuSetSettings(settings.density);
+    LCD_setCursorPosition(2, 10);
+    if (settings.density == SUBMENU_DENSITY_STD)
+    {
+      // Show MOHs menu for standard density
+      Display_showSubmenuSetSettings(settings.mohs);
+    }
+    else
+    {
+      // Show weight menu for light density
+      Display_showSubmenuSetSettings(settings.weight);
+    }
+  }
+}
+
+
+//******************************************************************************
+//
+//  Function: Display_showSubmenuSummary()
+//
+//  Description:
+//  ============
+//  This function shows the statistics of the stored tests for one power
+//  setting.  The up and down keys select the power and the enter key steps
+//  through the average, minimum, maximum and standard deviation.
+//
+//******************************************************************************
+void Display_showSubmenuSummary(void)
+{
+  byte              group;
+  byte              point;
+  byte              total;
+  int32             value;
+
+  if (menuState == MENU_STATE_ENTER)
+  {
+    Peripheral_flushData();
+    total = 0;
+    for (group = 0 ; group < STATS_GROUPS ; group++)
+    {
+      if (!Config_loadStatistics(group))
+      {
+        total = 0xff;
+        break;
+      }
+      total += statistics.count;
+    }
+    if (total != testSetCount)
+    {
+      Config_rebuildStatistics();
+    }
+    keyCount = MENU_TABLE[MENU_SUMMARY].keyMin;
+    keyMax = MENU_TABLE[MENU_SUMMARY].keyMax;
+    keyMin = MENU_TABLE[MENU_SUMMARY].keyMin;
+    keySet = false;
+    menuState = MENU_STATE_ACTIVE;
+    summaryView = SUMMARY_VIEW_AVERAGE;
+  }
+
+  if (keySet)
+  {
+    keySet = false;
+    if (++summaryView == SUMMARY_VIEW_COUNT)
+    {
+      summaryView = SUMMARY_VIEW_AVERAGE;
+    }
+  }
+
+  Config_loadStatistics(keyCount - SUBMENU_POWER_STD);
+  value = 0;
+  if (statistics.count)
+  {
+    if (summaryView == SUMMARY_VIEW_MINIMUM)
+    {
+      value = statistics.low;
+    }
+    else if (summaryView == SUMMARY_VIEW_MAXIMUM)
+    {
+      value = statistics.high;
+    }
+    else
+    {
+      value = statistics.sum / statistics.count;
+      if (summaryView == SUMMARY_VIEW_DEVIATION)
+      {
+        value = Display_calculateRoot(statistics.squares / statistics.count - value * value);
+      }
+    }
+  }
+
+  LCD_clearDisplay();
+  LCD_setCursorPosition(1, 1);
+  LCD_showLabel(SETTING_LABEL[0][keyCount]);
+  LCD_setCursorPosition(1, 12);
+  strcpy(lcdData, "N:");
+  lcdPosition = 2;
+  Display_showDecimal(statistics.count);
+  lcdData[++lcdPosition] = 0;
+  LCD_updateDisplay();
 
-   if (submenuUnits == SUBMENU_UNITS_MPA)
+  if (settings.units == SUBMENU_UNITS_MPA)
   {
-      switch(data){
-      case SUBMENU_AGG_SIZE_SMALL:
-         strcpy(lcdData, "25mm-S");
-         break;
-      case SUBMENU_AGG_SIZE_LARGE:
-         strcpy(lcdData, "50mm-L");
-         break;
-      case SUBMENU_WEIGHT_HIGH:
-         strcpy(lcdData, ">.83-h ");
-         break;         
-      case SUBMENU_WEIGHT_MED:
-         strcpy(lcdData, ".83-79m");
-         break;         
-      case SUBMENU_WEIGHT_LOW:
-         strcpy(lcdData, "<.79-l ");
-         break;                  
-      }
+    strcpy(lcdData, "MPA:");
+    point = 4;
   }
   else
   {
-      switch(data){
-      case SUBMENU_AGG_SIZE_SMALL:
-         strcpy(lcdData, "1in.-S");
-         break;
-      case SUBMENU_AGG_SIZE_LARGE:
-         strcpy(lcdData, "2in.-L");
-         break;
-      case SUBMENU_WEIGHT_HIGH:
-         strcpy(lcdData, ">120-h ");
-         break;         
-      case SUBMENU_WEIGHT_MED:
-         strcpy(lcdData, "115-20m");
-         break;         
-      case SUBMENU_WEIGHT_LOW:
-         strcpy(lcdData, "<115-l ");
-         break;                  
-      }
+    strcpy(lcdData, "PSI:");
+    point = DISPLAY_DIGITS;
   }
+  lcdPosition = 4;
+  Display_showNumber((value * settings.pressureMult) >> PRESSURE_SHIFT, DISPLAY_DIGITS, point);
+  lcdData[lcdPosition] = 0;
+  LCD_setCursorPosition(2, 1);
+  LCD_updateDisplay();
+  LCD_setCursorPosition(2, 13);
+  LCD_showLabel(SUMMARY_LABEL[summaryView]);
 }
 
 
 //******************************************************************************
 //
-//  Function: Display_showSubmenuShowSettings()
+//  Function: Display_showTableDigits()
 //
 //  Description:
 //  ============
-//  This function sends the Show Settings submenu data to the display.
+//  This function copies the next digits of the display table entry to the
+//  display, starting at lcdPosition.  A decimal point is put in front of digit
+//  number "point"; pass point >= digits for no decimal point.
 //
 //******************************************************************************
-void Display_showSubmenuShowSettings(void)
+void Display_showTableDigits(byte digits, byte point)
 {
-  if (menuInitSubmenu)
-  {
-    menuInitSubmenu = false;
-    menuShowSubmenu = true;
-    keySet = false;
-    LCD_clearDisplay();
-  }
-  if (keySet)
-  {
-    keyClear = true;
-  }
-  Display_showSubmenuSetSettings(submenuPower);
-  LCD_setCursorPosition(1, 1);
-  LCD_updateDisplay();
-  Display_showSubmenuSetSettings(submenuAggSize);
-  LCD_setCursorPosition(1, 11);
-  LCD_updateDisplay();
-  if (submenuPower != SUBMENU_POWER_HIGH)
+  byte              i;
+
+  for (i = 0 ; i < digits ; i++)
   {
-    Display_showSubmenuSetSettings(submenuDensity);
-    LCD_setCursorPosition(2, 1);
-    LCD_updateDisplay();
-    if (submenuDensity == SUBMENU_DENSITY_STD)
+    if (i == point)
     {
-      // Show MOHs menu for standard density
-      Display_showSubmenuSetSettings(submenuMohs);
-    }
-    else
-    {
-      // Show weight menu for light density
-      Display_showSubmenuSetSettings(submenuWeight);
+      lcdData[lcdPosition++] = '.';
     }
-    LCD_setCursorPosition(2, 10);
-    LCD_updateDisplay();
+    lcdData[lcdPosition++] = (make8(tableEntry, 3) >> 4) + '0';
+    tableEntry <<= 4;
   }
 }
 
@@ -1593,34 +2224,31 @@ void Display_showTime(void)
 //  This function copies the pressure data to the display.
 //
 //******************************************************************************
-void Display_updateDisplayPressure(int32 pressure)
+void Display_updateDisplayPressure(Settings *s, int32 pressure)
 {
-  byte              digit;
-  int32              divisor;
-  byte              i;
+  byte              point;
 
-  if (submenuUnits == SUBMENU_UNITS_MPA)
+  if (s->units == SUBMENU_UNITS_MPA)
   {
     strcpy(lcdData, "MPA:");
-    lcdPosition = 4;
+    point = 4;
   }
   else
   {
     strcpy(lcdData, "PSI:");
-    lcdPosition = 4;
-    pressure = pressure * 145 / 10;
+    point = DISPLAY_DIGITS;
   }
-    divisor = 10000;
-  for (i = 0 ; i < 5 ; ++i)
+  lcdPosition = 4;
+#ifdef DISPLAY_TABLE
+  if (tableReady && (s == &settings))
   {
-      digit = pressure / divisor;
-      pressure -= digit * divisor;
-      divisor /= 10;
-      if ((i == 4) && (submenuUnits == SUBMENU_UNITS_MPA))
-      {
-        lcdData[lcdPosition++] = '.';
-      }
-      lcdData[lcdPosition++] = digit + '0';
+    Display_showTableDigits(DISPLAY_DIGITS, point);
+  }
+  else
+#endif
+  {
+    pressure = (pressure * s->pressureMult) >> PRESSURE_SHIFT;
+    Display_showNumber(pressure, DISPLAY_DIGITS, point);
   }
 
   lcdData[lcdPosition++] = ' '; 
@@ -1807,6 +2435,30 @@ void LCD_setCursorPosition(byte row, byte col)
 }
 
 
+//******************************************************************************
+//
+//  Function: LCD_showLabel()
+//
+//  Description:
+//  ============
+//  This function sends the passed label from ROM to the display at the current
+//  cursor position.
+//
+//******************************************************************************
+void LCD_showLabel(byte label)
+{
+  char              data;
+  byte              temp = 0;
+
+  data = LABEL_TEXT[label][0];
+  while (data != 0)
+  {
+    LCD_writeData(data);
+    data = LABEL_TEXT[label][++temp];
+  }
+}
+
+
 //******************************************************************************
 //
 //  Function: LCD_turnOffCursor()
@@ -1862,21 +2514,16 @@ void LCD_turnOnCursor(void)
 //******************************************************************************
 void LCD_updateDisplay(void)
 {
+  long              start;
   byte              temp = 0;
 
+  PERF_START(start);
   while (lcdData[temp]!=0)
   {
-    LCD_waitForReadySignal();
-    output_high(PIN_A1);                // Set the RS line high
-    output_low(PIN_A2);                 // Set the R/W line low
-    delay_cycles(1);
-    output_high(PIN_A3);                // Set the enable line high
-    delay_cycles(1);                    // Wait
-    lcd_port = lcdData[temp];
-    delay_cycles(2);
-    output_low(PIN_A3);                 // Set the enable line low
+    LCD_writeData(lcdData[temp]);
     temp++;
   }
+  PERF_STOP(PERF_LCD, start);
 }
 
 
@@ -1914,6 +2561,29 @@ void LCD_waitForReadySignal(void)
 }
 
 
+//******************************************************************************
+//
+//  Function: LCD_writeData()
+//
+//  Description:
+//  ============
+//  This function sends one character to the display.
+//
+//******************************************************************************
+void LCD_writeData(byte data)
+{
+  LCD_waitForReadySignal();
+  output_high(PIN_A1);                  // Set the RS line high
+  output_low(PIN_A2);                   // Set the R/W line low
+  delay_cycles(1);
+  output_high(PIN_A3);                  // Set the enable line high
+  delay_cycles(1);                      // Wait
+  lcd_port = data;
+  delay_cycles(2);
+  output_low(PIN_A3);                   // Set the enable line low
+}
+
+
 //******************************************************************************
 //  Main Function
 //******************************************************************************
@@ -1935,6 +2605,7 @@ void main(void)
 {
   byte              i;
   byte              key;
+  long              loopStart;
 
   set_tris_a(1);                        // Make PORT A pin 1 an input
   set_tris_b(0xf3);                     // Make PORT B 0-3 in 4-7 out
@@ -1958,12 +2629,25 @@ void main(void)
   lcd_port = 0x38;                      // Set the LCD to 8 bits and 2 lines
   LCD_turnOffCursor();
 
+  // The UART buffer must be empty before the transmit interrupt is enabled
+  uartHead = 0;
+  uartTail = 0;
+
+  saveState = SAVE_STATE_IDLE;
   Peripheral_readRTC();
+  Config_loadSetup();
   Config_initialize();
+#ifdef PERF_COUNTERS
+  setup_timer_1(T1_INTERNAL | T1_DIV_BY_8);
+  Diagnostic_clearCounters();
+#endif
+  enable_interrupts(GLOBAL);
 
   // Main forever loop
   while (true)
   {
+    PERF_START(loopStart);
+
     // Check for keypresses
     key = Keyboard_getKeypress();
     if (keyNewDetection)
@@ -1985,37 +2669,20 @@ void main(void)
          break;          
       }    
       //display main menu
-      if (keyCountNew && !menuShowSubmenu)
+      if (keyCountNew && menuState == MENU_STATE_BROWSE)
       {
-         switch(keyCount){
-         case MENU_MEASURE:
-           strcpy(lcdData, "Measure");
-           break;
-         case MENU_RUN_TEST:
-            strcpy(lcdData, "Run Test");
-            break;
-         case MENU_SHOW_TESTS:
-           strcpy(lcdData, "Show Tests");
-           break;
-         case MENU_DOWNLOAD_TESTS:
-            strcpy(lcdData, "Download Tests");
-            break;
-          case MENU_ENTER_SETUP:
-            strcpy(lcdData, "Enter Setup");
-            break;
-         }
          showTime = false;
          LCD_clearDisplay();
-         LCD_updateDisplay();
+         LCD_showLabel(MENU_TABLE[Config_getMenuChild(MENU_MAIN)].label);
       }
 
-      if (keySet && !menuShowSubmenu)
+      if (keySet && menuState == MENU_STATE_BROWSE)
       {
-        menuLocationNum = keyCount;
-        menuInitSubmenu = true;
+        menuLocationNum = Config_getMenuChild(MENU_MAIN);
+        menuState = MENU_STATE_ENTER;
       }
 
-      if (menuInitSubmenu || menuShowSubmenu)
+      if (menuState != MENU_STATE_BROWSE)
       {
         switch(menuLocationNum){
         case MENU_MEASURE:
@@ -2059,6 +2726,12 @@ void main(void)
         case MENU_CALIBRATE:
           Display_showSubmenuCalibrate();
           break;        
+        case MENU_DIAGNOSTICS:
+          Display_showSubmenuDiagnostics();
+          break;
+        case MENU_SUMMARY:
+          Display_showSubmenuSummary();
+          break;
         }
       }
 
@@ -2071,57 +2744,408 @@ void main(void)
       }
     }
 
-    // Update the title
-    if (showTitle)
+    // Write the queued test in the background
+    Peripheral_writeData();
+
+    // Update the title
+    if (showTitle)
+    {
+      showTitle = false;
+      LCD_clearDisplay();
+      LCD_turnOffCursor();
+      strcpy(lcdData, "Stored Tests:");
+      lcdPosition = 13;
+      Display_showDecimal(testSetCount);
+      lcdData[++lcdPosition] = 0;
+      LCD_setCursorPosition(2, 1);
+      LCD_updateDisplay();
+      timeUpdate = true;
+    }
+
+    // Update the time
+    if (showTime)
+    {
+      Peripheral_readRTC();
+      if (timeUpdate)
+      {
+        timeUpdate = false;
+        Display_showTime();
+        LCD_setCursorPosition(1, 1);
+        LCD_updateDisplay();
+      }
+    }
+
+    PERF_STOP(PERF_MAIN_LOOP, loopStart);
+  }
+}
+
+
+//******************************************************************************
+//  Peripheral Functions
+//******************************************************************************
+
+//******************************************************************************
+//
+//  Function: Peripheral_addressEEPROM()
+//
+//  Description:
+//  ============
+//  This function starts an EEPROM transfer at eepromMemPtr.  The EEPROM does
+//  not acknowledge its address while a write cycle is in progress, so the
+//  start is repeated until it does.  A write therefore returns as soon as its
+//  data is sent and the next transfer only waits for whatever is left of the
+//  write cycle, instead of every write waiting a fixed 12 ms.
+//
+//******************************************************************************
+void Peripheral_addressEEPROM(void)
+{
+  byte              i;
+
+  i = EEPROM_POLL_LIMIT;
+  do
+  {
+    i2c_start();
+  } while (i2c_write(0xA0) && --i);
+  i2c_write(make8(eepromMemPtr,1));
+  i2c_write(make8(eepromMemPtr,0));
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_checkEEPROM()
+//
+//  Description:
+//  ============
+//  This function returns true if the EEPROM has finished its write cycle.
+//
+//******************************************************************************
+short int Peripheral_checkEEPROM(void)
+{
+  short int         ready;
+
+  i2c_start();
+  ready = !i2c_write(0xA0);
+  i2c_stop();
+  return (ready);
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_findRecord()
+//
+//  Description:
+//  ============
+//  This function returns the number of the first test stored at or after the
+//  passed packed time, or testSetCount + 1 if there is none.  The tests are in
+//  time order, so this binary search reads at most 7 times for 99 tests.
+//
+//******************************************************************************
+byte Peripheral_findRecord(int32 stamp)
+{
+  byte              high;
+  byte              low;
+  byte              middle;
+  byte              time[RECORD_TIME_SIZE];
+
+  low = 1;
+  high = testSetCount + 1;
+  while (low < high)
+  {
+    middle = (low + high) >> 1;
+    Peripheral_readRecordTimes(middle, 1, time);
+    if (Peripheral_packTime(time) < stamp)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return (low);
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_flushData()
+//
+//  Description:
+//  ============
+//  This function waits until the queued test is written to the EEPROM.  It
+//  must be called before the stored tests are read or cleared.
+//
+//  NOTE: If the EEPROM stays busy for EEPROM_POLL_LIMIT polls in a row, the
+//        error is shown and the rest of the queue is dropped, so a dead
+//        EEPROM can't hang the menu.  The test is dropped too unless only its
+//        statistics were left to write.
+//
+//******************************************************************************
+#inline
+void Peripheral_flushData(void)
+{
+  byte              i;
+  byte              state;
+
+  i = EEPROM_POLL_LIMIT;
+  while (saveState != SAVE_STATE_IDLE)
+  {
+    state = saveState;
+    Peripheral_writeData();
+    if (saveState != state)
+    {
+      i = EEPROM_POLL_LIMIT;
+    }
+    else if (!--i)
+    {
+      // A test whose record or count was never written is dropped.  If only
+      // the statistics are missing, their counts no longer add up to
+      // testSetCount, so Display_showSubmenuSummary() rebuilds them.
+      if (saveState != SAVE_STATE_STATS)
+      {
+        --testSetCount;
+      }
+      saveState = SAVE_STATE_IDLE;
+      LCD_setCursorPosition(2, 1);
+      LCD_showLabel(LABEL_EEPROM_ERROR);
+      delay_ms(2000);
+    }
+  }
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_flushUART()
+//
+//  Description:
+//  ============
+//  This function waits until the UART transmit buffer is empty.
+//
+//******************************************************************************
+void Peripheral_flushUART(void)
+{
+  while (uartHead != uartTail)
+  {
+  }
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_getADC()
+//
+//  Description:
+//  ============
+//  This function gets the ADC reading.  A burst of ADC_BURST_SIZE samples is
+//  taken at the full conversion rate and the mean of the middle samples is
+//  used, so a single noisy sample can't move the reading.
+//
+//******************************************************************************
+void Peripheral_getADC(void)
+{
+  byte              i;
+  byte              j;
+  byte              sample;
+  byte              samples[ADC_BURST_SIZE];
+  long              start;
+  long              total;
+
+  PERF_START(start);
+  setup_port_a(A_ANALOG);
+  set_adc_channel(0);
+  delay_ms(100);
+
+  // Take the burst back to back, keeping the samples sorted
+  for (i = 0 ; i < ADC_BURST_SIZE ; i++)
+  {
+    delay_us(20);                       // ADC acquisition time
+    sample = read_adc();
+    j = i;
+    while (j && (samples[j - 1] > sample))
+    {
+      samples[j] = samples[j - 1];
+      --j;
+    }
+    samples[j] = sample;
+  }
+  setup_port_a(NO_ANALOGS);
+
+  total = (ADC_BURST_SIZE - 2 * ADC_BURST_TRIM) / 2;   // Round to nearest
+  for (i = ADC_BURST_TRIM ; i < ADC_BURST_SIZE - ADC_BURST_TRIM ; i++)
+  {
+    total += samples[i];
+  }
+  adcReading = total / (ADC_BURST_SIZE - 2 * ADC_BURST_TRIM);
+  PERF_STOP(PERF_ADC, start);
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_packTime()
+//
+//  Description:
+//  ============
+//  This function returns the passed test time (RECORD_MINUTES to RECORD_YEAR)
+//  as one number that grows with the time.  The BCD fields are kept as they
+//  are, since they only need to compare in the right order, except the hours.
+//  Set Clock leaves the clock in 12 hour mode (bit 6 set, bit 5 for PM and 1
+//  to 12 in BCD), which doesn't order, so the hours are packed as 0 to 23.
+//
+//******************************************************************************
+int32 Peripheral_packTime(byte *time)
+{
+  byte              hours;
+  int32             stamp;
+
+  hours = time[RECORD_HOURS];
+  if (bit_test(hours, 6))
+  {
+    // 12 hour mode: 12 AM is hour 0 and PM adds 12
+    hours = ((hours >> 4) & 0x01) * 10 + (hours & 0x0f);
+    if (hours == 12)
     {
-      showTitle = false;
-      LCD_clearDisplay();
-      LCD_turnOffCursor();
-      strcpy(lcdData, "Stored Tests:");
-      lcdPosition = 13;
-      Display_showDecimal(testSetCount);
-      lcdData[++lcdPosition] = 0;
-      LCD_setCursorPosition(2, 1);
-      LCD_updateDisplay();
-      timeUpdate = true;
+      hours = 0;
     }
-
-    // Update the time
-    if (showTime)
+    if (bit_test(time[RECORD_HOURS], 5))
     {
-      Peripheral_readRTC();
-      if (timeUpdate)
-      {
-        timeUpdate = false;
-        Display_showTime();
-        LCD_setCursorPosition(1, 1);
-        LCD_updateDisplay();
-      }
+      hours += 12;
     }
   }
+  else
+  {
+    hours = ((hours >> 4) & 0x03) * 10 + (hours & 0x0f);
+  }
+
+  stamp = time[RECORD_YEAR];
+  stamp = (stamp << 5) | time[RECORD_MONTH];
+  stamp = (stamp << 6) | time[RECORD_DAY];
+  stamp = (stamp << 6) | hours;
+  stamp = (stamp << 7) | time[RECORD_MINUTES];
+  return (stamp);
 }
 
 
 //******************************************************************************
-//  Peripheral Functions
+//
+//  Function: Peripheral_putUART()
+//
+//  Description:
+//  ============
+//  This function adds the passed byte to the UART transmit buffer and returns
+//  without waiting for it to be sent.  It only waits when the buffer is full.
+//
 //******************************************************************************
+void Peripheral_putUART(byte data)
+{
+  byte              next;
+
+  next = (uartHead + 1) & UART_BUFFER_MASK;
+  while (next == uartTail)
+  {
+  }
+  uartBuffer[uartHead] = data;
+  uartHead = next;
+  enable_interrupts(INT_TBE);
+}
+
 
 //******************************************************************************
 //
-//  Function: Peripheral_getADC()
+//  Function: Peripheral_readCommand()
 //
 //  Description:
 //  ============
-//  This function gets the ADC reading.
+//  This function answers a serial command from the PC, if one has been
+//  received.  See the COMMAND_* definitions for the commands and replies.
+//  Anything else, including a command whose arguments do not arrive, is
+//  ignored.
 //
 //******************************************************************************
-void Peripheral_getADC(void)
+void Peripheral_readCommand(void)
 {
-  setup_port_a(A_ANALOG);
-  set_adc_channel(0);
-  delay_ms(100);
-  adcReading = read_adc();
-  setup_port_a(NO_ANALOGS);
+  byte              args[COMMAND_ARGS_MAX];
+  byte              command;
+  byte              count;
+  byte              first;
+  byte              i;
+  byte              last;
+
+  if (!kbhit())
+  {
+    return;
+  }
+  command = getc();
+  if ((command == COMMAND_DELTAS) || (command == COMMAND_RECORDS))
+  {
+    count = 2;
+  }
+  else if (command == COMMAND_SINCE)
+  {
+    count = RECORD_TIME_SIZE;
+  }
+  else
+  {
+    count = 0;
+  }
+  for (i = 0 ; i < count ; i++)
+  {
+    if (!Peripheral_readUART(&args[i]))
+    {
+      return;
+    }
+  }
+
+  switch (command)
+  {
+  case COMMAND_CALIBRATION:
+    Peripheral_putUART(settings.zero + 48);
+    Peripheral_putUART(settings.fullScale + 48);
+    break;
+  case COMMAND_DELTAS:
+  case COMMAND_RECORDS:
+    first = args[0];
+    last = args[1];
+    if (first == 0)
+    {
+      first = 1;
+    }
+    if (last > testSetCount)
+    {
+      last = testSetCount;
+    }
+    if (command == COMMAND_DELTAS)
+    {
+      Peripheral_sendRecords(first, last, SEND_MODE_DELTAS);
+    }
+    else
+    {
+      Peripheral_sendRecords(first, last, SEND_MODE_RECORDS);
+    }
+    break;
+  case COMMAND_PERFORMANCE:
+    Diagnostic_sendCounters();
+    break;
+  case COMMAND_SETTINGS:
+    Peripheral_putUART(settings.power + 48);
+    Peripheral_putUART(settings.density + 48);
+    Peripheral_putUART(settings.weight + 48);
+    Peripheral_putUART(settings.mohs + 48);
+    Peripheral_putUART(settings.units + 48);
+    Peripheral_putUART(settings.aggSize + 48);
+    break;
+  case COMMAND_SINCE:
+    // The reply starts at the first test at or after the time and runs to
+    // the last
+    first = Peripheral_findRecord(Peripheral_packTime(args));
+    Peripheral_sendRecords(first, testSetCount, SEND_MODE_RECORDS);
+    break;
+  }
+  LCD_setCursorPosition(2, 1);
+  LCD_showLabel(LABEL_CONNECT_PC);
 }
 
 
@@ -2136,21 +3160,107 @@ void Peripheral_getADC(void)
 //******************************************************************************
 byte Peripheral_readEEPROM(void)
 {
+  long              start;
   byte              temp;
 
-  i2c_start();
-  i2c_write(0xA0);
-  
-  i2c_write(make8(eepromMemPtr,1));
-  i2c_write(make8(eepromMemPtr,0));
+  PERF_START(start);
+  Peripheral_addressEEPROM();
   i2c_start();
   i2c_write(0xA0|1);
   temp = i2c_read(0);
   i2c_stop();
+  PERF_STOP(PERF_EEPROM_READ, start);
   return (temp);
 }
 
 
+//******************************************************************************
+//
+//  Function: Peripheral_readEEPROMBlock()
+//
+//  Description:
+//  ============
+//  This function reads "count" bytes from the EEPROM, starting at eepromMemPtr,
+//  with one sequential read.
+//
+//******************************************************************************
+void Peripheral_readEEPROMBlock(byte *data, byte count)
+{
+  byte              i;
+  long              start;
+
+  PERF_START(start);
+  Peripheral_addressEEPROM();
+  i2c_start();
+  i2c_write(0xA0|1);
+  for (i = 1 ; i < count ; i++)
+  {
+    *data++ = i2c_read();                 // + ACK
+  }
+  *data = i2c_read(0);                    // + NACK
+  i2c_stop();
+  PERF_STOP(PERF_EEPROM_READ, start);
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_readRecord()
+//
+//  Description:
+//  ============
+//  This function reads test number "test" (1 to testSetCount) into the passed
+//  TEST_SET_SIZE byte buffer.  See the RECORD_* offsets for its fields.
+//
+//******************************************************************************
+void Peripheral_readRecord(byte test, byte *data)
+{
+  eepromMemPtr = (long)(test - 1) * TEST_SET_SIZE;
+  Peripheral_readEEPROMBlock(data, TEST_SET_SIZE);
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_readRecordTimes()
+//
+//  Description:
+//  ============
+//  This function reads the times of "count" tests, starting at test number
+//  "first", with one sequential read.  The RECORD_TIME_SIZE bytes of each time
+//  are stored one after the other in the passed buffer.
+//
+//******************************************************************************
+void Peripheral_readRecordTimes(byte first, byte count, byte *data)
+{
+  byte              i;
+  byte              j;
+  byte              temp;
+
+  eepromMemPtr = (long)(first - 1) * TEST_SET_SIZE;
+  Peripheral_addressEEPROM();
+  i2c_start();
+  i2c_write(0xA0|1);
+  for (i = 1 ; i < count ; i++)
+  {
+    for (j = 0 ; j < TEST_SET_SIZE ; j++)
+    {
+      temp = i2c_read();                  // + ACK
+      if (j < RECORD_TIME_SIZE)
+      {
+        *data++ = temp;
+      }
+    }
+  }
+  for (j = 1 ; j < RECORD_TIME_SIZE ; j++)
+  {
+    *data++ = i2c_read();                 // + ACK
+  }
+  *data = i2c_read(0);                    // + NACK
+  i2c_stop();
+}
+
+
 //******************************************************************************
 //
 //  Function: Peripheral_readRTC()
@@ -2163,8 +3273,10 @@ byte Peripheral_readEEPROM(void)
 void Peripheral_readRTC(void)
 {
   byte              i;
+  long              start;
   byte              temp;
 
+  PERF_START(start);
   temp = timeRTCData[1];                // Save the RTC minutes to test for display change
   i2c_start();
   i2c_write(0xD0);                      // I2C slave read mode - rtc clock address
@@ -2179,88 +3291,190 @@ void Peripheral_readRTC(void)
 
    timeRTCData[6] = i2c_read(0);         // + NACK
   i2c_stop();
+  PERF_STOP(PERF_RTC, start);
 
-  if (temp != timeRTCData[1] && !menuShowSubmenu)
+  if (temp != timeRTCData[1] && menuState == MENU_STATE_BROWSE)
   {
     timeUpdate = true;                  // Test RTC clock for minutes change
   }
 }
 
 
+//******************************************************************************
+//
+//  Function: Peripheral_readUART()
+//
+//  Description:
+//  ============
+//  This function waits up to COMMAND_TIMEOUT ms for a byte from the PC.  It
+//  returns false if none arrives.
+//
+//******************************************************************************
+short int Peripheral_readUART(byte *data)
+{
+  byte              i;
+
+  for (i = 0 ; i < COMMAND_TIMEOUT ; i++)
+  {
+    if (kbhit())
+    {
+      *data = getc();
+      return (true);
+    }
+    delay_ms(1);
+  }
+  return (false);
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_readUploadAck()
+//
+//  Description:
+//  ============
+//  This function counts the DOWNLOAD_ACK bytes received from the PC.  Each
+//  one acknowledges the next test, and the count is saved at once so an
+//  interrupted download resumes after the last test the PC has stored.  A PC
+//  that never acknowledges gets every test on each download, as before.
+//
+//******************************************************************************
+void Peripheral_readUploadAck(void)
+{
+  while (kbhit())
+  {
+    if ((getc() == DOWNLOAD_ACK) && (testUploaded < testSetCount))
+    {
+      ++testUploaded;
+      eepromMemPtr = EEPROM_UPLOADED;
+      Peripheral_writeEEPROM(testUploaded);
+    }
+  }
+}
+
+
 //******************************************************************************
 //
 //  Function: Peripheral_saveData()
 //
 //  Description:
 //  ============
-//  This function saves data to the EEPROM.
+//  This function queues the test for Peripheral_writeData() to save to the
+//  EEPROM, so the menu doesn't wait for the EEPROM write cycles.  A test is
+//  never stamped earlier than the one before it.
 //
 //******************************************************************************
 void Peripheral_saveData(void)
 {
-  int     i;
-
-  //eepromMemPtr = testSetCount * TEST_SET_SIZE;  // Since this line that doesn't work, it has been replaced with a loop.
-  eepromMemPtr = 0;
-  for (i = 0; i < testSetCount ; i++)
-  {
-    eepromMemPtr += TEST_SET_SIZE;
-  }
-  Peripheral_writeEEPROM(timeRTCData[1]);         // EEPROM Data Offset  0 minutes
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(timeRTCData[2]);         // EEPROM Data Offset  1 hours
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(timeRTCData[4]);         // EEPROM Data Offset  2 day
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(timeRTCData[5]);         // EEPROM Data Offset  3
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(timeRTCData[6]);         // EEPROM Data Offset  4
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(submenuPower);           // EEPROM Data Offset  5
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(submenuDensity);         // EEPROM Data Offset  6
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(submenuWeight);          // EEPROM Data Offset  7
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(submenuMohs);            // EEPROM Data Offset  8
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(submenuUnits);           // EEPROM Data Offset  9
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(submenuAggSize);         // EEPROM Data Offset 10
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(adcZero);                // EEPROM Data Offset 11
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(adcFullScale);           // EEPROM Data Offset 12
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(adcData[0]);             // EEPROM Data Offset 13
-  ++eepromMemPtr;
-  Peripheral_writeEEPROM(adcData[1]);             // EEPROM Data Offset 14
-   ++eepromMemPtr;
-  Peripheral_writeEEPROM(adcData[2]);             // EEPROM Data Offset 15
+  byte              i;
+  byte              time[RECORD_TIME_SIZE];
+
+  Peripheral_flushData();                         // Only one test is queued
+  saveRecord[RECORD_MINUTES] = timeRTCData[1];
+  saveRecord[RECORD_HOURS] = timeRTCData[2];
+  saveRecord[RECORD_DAY] = timeRTCData[4];
+  saveRecord[RECORD_MONTH] = timeRTCData[5];
+  saveRecord[RECORD_YEAR] = timeRTCData[6];
+  if (testSetCount)
+  {
+    // Keep the tests in time order if the clock has been set back
+    Peripheral_readRecordTimes(testSetCount, 1, time);
+    if (Peripheral_packTime(saveRecord) < Peripheral_packTime(time))
+    {
+      memcpy(saveRecord, time, RECORD_TIME_SIZE);
+    }
+  }
+  memcpy(&saveRecord[RECORD_POWER], &settings, SETTINGS_SIZE);
+  for (i = 0 ; i < TEST_SHOTS ; i++)
+  {
+    saveRecord[RECORD_SHOTS + i] = adcData[i];
+  }
   ++testSetCount;
-  eepromMemPtr = EEPROM_TESTS;
-  Peripheral_writeEEPROM(testSetCount);
-  dataClear = false;                                // Added for download data after a test after the first time
+  saveState = SAVE_STATE_RECORD;
 }
 
 
 //******************************************************************************
 //
-//  Function: Peripheral_scaleADC()
+//  Function: Peripheral_sendRecords()
 //
 //  Description:
 //  ============
-//  This function sets the ADC reading scaling factor for metric units.
-//  If imperial readings are desired, then a conversion factor is used prior to
-//  displaying the reading.
+//  This function sends the number of tests from "first" to "last", followed
+//  by those tests, showing each test number as it goes.  Each test is read
+//  from the EEPROM while the previous one is transmitted.  With
+//  SEND_MODE_DELTAS, each test only carries the DELTA_FIELDS that differ from
+//  the test before.  Only SEND_MODE_DOWNLOAD reads the PC's ACKs; a command
+//  reply leaves the received bytes for Peripheral_readCommand().
 //
 //******************************************************************************
-void Peripheral_scaleADC(void)
+void Peripheral_sendRecords(byte first, byte last, byte mode)
 {
-  byte              span;
+  long              address;
+  byte              data[TEST_SET_SIZE];
+  byte              flags;
+  byte              group;
+  byte              i;
+  byte              previous[RECORD_SHOTS];
+
+  if (first > last)
+  {
+    Peripheral_putUART(48);
+    return;
+  }
+
+  LCD_setCursorPosition(2, 1);
+  LCD_showLabel(LABEL_SENDING);
+  Peripheral_putUART(last - first + 1 + 48);
+  address = (long)(first - 1) * TEST_SET_SIZE;
+  flags = (1 << DELTA_GROUPS) - 1;                // The first test is sent in full
+  for ( ; first <= last ; first++)
+  {
+    lcdPosition = 0;
+    Display_showDecimal(first);
+    lcdData[++lcdPosition] = 0;
+    LCD_setCursorPosition(2, 9);
+    LCD_updateDisplay();
 
-  span = (adcFullScale - adcZero) - 1;
-  adcScale = ADC_SCALE_FACTOR_METRIC / span;
+    eepromMemPtr = address;
+    Peripheral_readEEPROMBlock(data, TEST_SET_SIZE);
+    address += TEST_SET_SIZE;
+    i = 0;
+    if (mode == SEND_MODE_DELTAS)
+    {
+      for (group = 0 ; group < DELTA_GROUPS ; group++)
+      {
+        for (i = DELTA_FIELDS[group] ; i < DELTA_FIELDS[group + 1] ; i++)
+        {
+          if (data[i] != previous[i])
+          {
+            flags |= 1 << group;
+          }
+        }
+      }
+      Peripheral_putUART(flags + 48);
+      for (group = 0 ; group < DELTA_GROUPS ; group++)
+      {
+        for (i = DELTA_FIELDS[group] ; i < DELTA_FIELDS[group + 1] ; i++)
+        {
+          if (flags & 1)
+          {
+            Peripheral_putUART(data[i] + 48);
+          }
+        }
+        flags >>= 1;                              // Leaves 0 for the next test
+      }
+      memcpy(previous, data, RECORD_SHOTS);
+    }
+    for ( ; i < TEST_SET_SIZE ; i++)
+    {
+      Peripheral_putUART(data[i] + 48);
+    }
+    if (mode == SEND_MODE_DOWNLOAD)
+    {
+      Peripheral_readUploadAck();
+    }
+  }
 }
 
 
@@ -2324,24 +3538,111 @@ void Peripheral_setRTC(void)
 }
 
 
+//******************************************************************************
+//
+//  Function: Peripheral_transmitUART()
+//
+//  Description:
+//  ============
+//  This is the UART transmit interrupt.  It sends the next byte in the
+//  transmit buffer and turns itself off once the buffer is empty.
+//
+//******************************************************************************
+#int_tbe
+void Peripheral_transmitUART(void)
+{
+  putc(uartBuffer[uartTail]);
+  uartTail = (uartTail + 1) & UART_BUFFER_MASK;
+  if (uartTail == uartHead)
+  {
+    disable_interrupts(INT_TBE);
+  }
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_writeData()
+//
+//  Description:
+//  ============
+//  This function writes the next part of the queued test to the EEPROM: the
+//  record with one page write, then the test count, then the statistics.  It
+//  returns at once while the EEPROM is busy, so the main loop can call it on
+//  every pass.
+//
+//******************************************************************************
+void Peripheral_writeData(void)
+{
+  if ((saveState == SAVE_STATE_IDLE) || !Peripheral_checkEEPROM())
+  {
+    return;
+  }
+  if (saveState == SAVE_STATE_RECORD)
+  {
+    eepromMemPtr = (long)(testSetCount - 1) * TEST_SET_SIZE;
+    Peripheral_writeEEPROMBlock(saveRecord, TEST_SET_SIZE);
+    saveState = SAVE_STATE_COUNT;
+  }
+  else if (saveState == SAVE_STATE_COUNT)
+  {
+    eepromMemPtr = EEPROM_TESTS;
+    Peripheral_writeEEPROM(testSetCount);
+    saveState = SAVE_STATE_STATS;
+  }
+  else
+  {
+    Config_addStatistics(saveRecord);
+    saveState = SAVE_STATE_IDLE;
+  }
+}
+
+
 //******************************************************************************
 //
 //  Function: Peripheral_writeEEPROM()
 //
 //  Description:
 //  ============
-//  This function writes the passed data to the EEPROM.
+//  This function writes the passed data to the EEPROM.  The write cycle runs
+//  on after this function returns; see Peripheral_addressEEPROM().
 //
 //******************************************************************************
 void Peripheral_writeEEPROM(byte data)
 {
-  i2c_start();
-  i2c_write(0xA0);
-  i2c_write(make8(eepromMemPtr,1));
-  i2c_write(make8(eepromMemPtr,0));
+  long              start;
+
+  PERF_START(start);
+  Peripheral_addressEEPROM();
   i2c_write(data);
   i2c_stop();
-  delay_ms(12);
+  PERF_STOP(PERF_EEPROM_WRITE, start);
+}
+
+
+//******************************************************************************
+//
+//  Function: Peripheral_writeEEPROMBlock()
+//
+//  Description:
+//  ============
+//  This function writes "count" bytes to the EEPROM, starting at eepromMemPtr,
+//  with one page write.  The bytes must not cross an EEPROM_PAGE_SIZE boundary.
+//
+//******************************************************************************
+void Peripheral_writeEEPROMBlock(byte *data, byte count)
+{
+  byte              i;
+  long              start;
+
+  PERF_START(start);
+  Peripheral_addressEEPROM();
+  for (i = 0 ; i < count ; i++)
+  {
+    i2c_write(*data++);
+  }
+  i2c_stop();
+  PERF_STOP(PERF_EEPROM_WRITE, start);
 }
 /*
 #ifdef DEBUG
@@ -30,13 +30,46 @@
 #define DEBUG
 #endif
 
+// Build the ADC to display lookup table in EEPROM
+#ifndef DISPLAY_TABLE
+#define DISPLAY_TABLE
+#endif
+
+// Take each Run Test shot automatically once a new reading settles
+// #define AUTO_ADVANCE
+
+// Time the hot paths with Timer1 for the Diagnostics menu
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS
+#endif
+
 #byte lcd_port = 8                                // LCD port is connected to port D (address 8)
 #byte kbd_port = 6                                // Keypad is connected to port B (address 6)
 
+// Common RAM: 0x70 to 0x7f is mapped into every bank, so the main loop state
+// kept there needs no bank selects.  CCS uses 0x77 and up as scratch.
+#define RAM_MAIN_FLAGS                  0x70      // See the #bit flags in Windsor.c
+#define RAM_MENU_STATE                  0x71
+#define RAM_MENU_LOCATION               0x72
+#define RAM_KEY_COUNT                   0x73
+#define RAM_KEY_MAX                     0x74
+#define RAM_KEY_MIN                     0x75
+
 // #define Macro
 #define getHighByte(a)                  (*(&a+1))
 
+// Performance counters: PERF_START() notes Timer1 in a local and PERF_STOP()
+// adds the time since then to a PERF_* counter
+#ifdef PERF_COUNTERS
+#define PERF_START(start)               start = get_timer1()
+#define PERF_STOP(counter, start)       Diagnostic_addTime(counter, start)
+#else
+#define PERF_START(start)
+#define PERF_STOP(counter, start)
+#endif
+
 // Menu locations
+#define MENU_MAIN                       0         //        Main                Menu
 #define MENU_MEASURE                    1         //        Main:Measure        Menu
 #define MENU_RUN_TEST                   2         //        Main:Run Test       Menu
 #define MENU_SHOW_TESTS                 3         //        Main:Show Tests     Menu
@@ -46,12 +79,17 @@
 #define MENU_SET_SETTINGS               7         // Enter Setup:Set Settings   Submenu
 #define MENU_SET_CLOCK                  8         // Enter Setup:Set Clock      Submenu
 #define MENU_CALIBRATE                  9         // Enter Setup:Calibrate      Submenu
+#define MENU_DIAGNOSTICS                10        // Enter Setup:Diagnostics    Submenu
+#define MENU_SUMMARY                    11        // Enter Setup:Summary        Submenu
+#define MENU_COUNT                      12
 
 //Submenu Setting
 #define SUBMENU_SET_SHOW                           1
 #define SUBMENU_SET_SET                            2
 #define SUBMENU_SET_CLOCK                          3
 #define SUBMENU_SET_CALIBRATE                      4
+#define SUBMENU_SET_DIAGNOSTICS                    5
+#define SUBMENU_SET_SUMMARY                        6
 
 // Submenu: Power
 #define SUBMENU_POWER_STD               1
@@ -88,6 +126,59 @@
 #define TEST_MAX_SETS                   99
 #define TEST_SET_SIZE                   16
 
+// Test Record: offsets of the fields in each TEST_SET_SIZE byte test, which is
+// stored at (test number - 1) * TEST_SET_SIZE
+#define RECORD_MINUTES                  0         // BCD, as read from the RTC
+#define RECORD_HOURS                    1
+#define RECORD_DAY                      2
+#define RECORD_MONTH                    3
+#define RECORD_YEAR                     4
+#define RECORD_POWER                    5         // SUBMENU_* settings
+#define RECORD_DENSITY                  6
+#define RECORD_WEIGHT                   7
+#define RECORD_MOHS                     8
+#define RECORD_UNITS                    9
+#define RECORD_AGG_SIZE                 10
+#define RECORD_ZERO                     11        // Calibration
+#define RECORD_FULL_SCALE               12
+#define RECORD_SHOTS                    13        // TEST_SHOTS ADC readings
+#define RECORD_TIME_SIZE                5         // RECORD_MINUTES to RECORD_YEAR
+
+// Packed Time: the BCD test time as year:8 month:5 day:6 hours:6 minutes:7
+// bits, so a later time is a larger number.  The tests are stored in time
+// order, which lets them be binary searched by packed time.
+#define STAMP_TIME_MASK                 0x1fff    // Hours and minutes
+
+// ADC Burst: samples taken for each reading, and the number of lowest and
+// highest samples dropped before the rest are averaged
+#define ADC_BURST_SIZE                  8
+#define ADC_BURST_TRIM                  2
+
+// Auto Advance: a shot is taken when the reading has moved more than
+// SHOT_TRIGGER from the last shot and then stayed within SHOT_SETTLE_BAND for
+// SHOT_SETTLE_COUNT readings
+#define SHOT_SETTLE_BAND                1
+#define SHOT_SETTLE_COUNT               3
+#define SHOT_TRIGGER                    4
+
+// Statistics: one block of STATS_SIZE bytes per power setting
+#define STATS_GROUPS                    3         // SUBMENU_POWER_STD to SUBMENU_POWER_HIGH
+#define STATS_SIZE                      16
+#define STATS_CHECK_SEED                0x5a
+#define STATS_STRENGTH_MAX              6585      // sqrt(2^32 / 99): the squares of 99 tests fit in 32 bits
+
+// Performance Counters: Timer1 runs at Fosc / 4 / 8, so a tick is 8 us and
+// one timing can be up to 524 ms
+#define PERF_TICK_US                    8
+
+// Show Tests: number of test times kept in RAM while scrolling
+#define SHOW_CACHE_SIZE                 8
+
+// Test Shots
+#define TEST_SHOTS                      3         // Shots per test
+#define TEST_SHOT_ALL                   0xfe      // Repeat the entire test
+#define TEST_SHOT_NONE                  0xff      // All shots are within the limit
+
 // EEPROM Memory Locations
 #define EEPROM_TOP                      8142
 #define EEPROM_POWER                    8143
@@ -99,6 +190,46 @@
 #define EEPROM_ZERO                     8149
 #define EEPROM_FULL_SCALE               8150
 #define EEPROM_TESTS                    8151
+#define EEPROM_UPLOADED                 8152      // Tests the PC has acknowledged
+#define EEPROM_TABLE                    7040      // Display table (page aligned)
+#define EEPROM_TABLE_KEY                8064      // TABLE_KEY_SIZE bytes, see Display_checkTable()
+#define EEPROM_PAGE_SIZE                32
+#define SETTINGS_SIZE                   8         // EEPROM_POWER to EEPROM_FULL_SCALE
+#define EEPROM_STATS                    8080      // Statistics, one block per power
+#define EEPROM_POLL_LIMIT               255       // ACK polls before giving up (> 20 ms)
+
+// Download Tests: the PC sends DOWNLOAD_ACK after storing each test
+#define DOWNLOAD_ACK                    0x06
+#define DOWNLOAD_ACK_WAIT               250       // ms to wait for the last ACK
+
+// Serial commands accepted while Download Tests shows "Connect PC".  Replies
+// are sent with 48 added to each byte, like a download.
+#define COMMAND_CALIBRATION             'C'       // Reply: zero, full scale
+#define COMMAND_DELTAS                  'D'       // Args: first, last test        Reply: count, delta tests
+#define COMMAND_PERFORMANCE             'P'       // Reply: PERF_COUNT, perfCounters
+#define COMMAND_RECORDS                 'R'       // Args: first, last test        Reply: count, tests
+#define COMMAND_SETTINGS                'S'       // Reply: EEPROM_POWER to EEPROM_AGG_SIZE
+#define COMMAND_SINCE                   'T'       // Args: RECORD_MINUTES to YEAR  Reply: count, tests
+#define COMMAND_ARGS_MAX                5
+#define COMMAND_TIMEOUT                 100       // ms to wait for each argument
+
+// Delta Tests: number of groups of fields in DELTA_FIELDS
+#define DELTA_GROUPS                    5
+
+// UART transmit ring buffer (the size must be a power of 2 and more than
+// TEST_SET_SIZE so a whole record can be queued while the next is read)
+#define UART_BUFFER_SIZE                32
+#define UART_BUFFER_MASK                (UART_BUFFER_SIZE - 1)
+
+// Display Table: one entry per ADC code holding the 3 distance digits and the
+// 5 pressure digits as packed BCD.  The key is the settings the table was
+// built for followed by TABLE_VERSION.  Bump TABLE_VERSION whenever the
+// OFFSET_*, SLOPE_* or display multiplier definitions change, so a table
+// built by older firmware is rebuilt.
+#define TABLE_ENTRY_SIZE                4
+#define TABLE_KEY_SIZE                  (SETTINGS_SIZE + 1)
+#define TABLE_VERSION                   1
+#define TABLE_WRITE_SIZE                16        // Entries written per EEPROM write
 
 // Keypad Connections: Column 0 is B3.
 #define COL0                            (1 << 3)
@@ -147,54 +278,458 @@
 
 // Conversion Factors
 #define ADC_SCALE_FACTOR_METRIC         3810
-#define DISTANCE_CONV_FACTOR            3.937
 #define DISTANCE_OFFSET_METRIC          2540
-#define PRESSURE_CONV_FACTOR            1.4503773773
+
+// Display Multipliers: displayed value = (value * MULT) >> SHIFT.  The unit
+// conversions are folded in, so no floating point is needed to display.
+#define DISTANCE_SHIFT                  21
+#define DISTANCE_MULT_METRIC            209716    // 2^21 / 10, shows 0.1 mm
+#define DISTANCE_MULT_IMPERIAL          82565     // 2^21 * 3.937 / 100, shows 0.01 in.
+#define PRESSURE_SHIFT                  1
+#define PRESSURE_MULT_METRIC            2         // 2^1
+#define PRESSURE_MULT_IMPERIAL          29        // 2^1 * 145 / 10
+
+// Display Digits
+#define DISPLAY_DIGITS                  5
 
 //******************************************************************************
 //  Enumerations
 //******************************************************************************
 
+// Labels: indexes into LABEL_TEXT
+enum
+{
+  LABEL_NONE,
+  LABEL_MEASURE,
+  LABEL_RUN_TEST,
+  LABEL_SHOW_TESTS,
+  LABEL_DOWNLOAD_TESTS,
+  LABEL_ENTER_SETUP,
+  LABEL_SHOW_SETTINGS,
+  LABEL_SET_SETTINGS,
+  LABEL_SET_CLOCK,
+  LABEL_CALIBRATE,
+  LABEL_DIAGNOSTICS,
+  LABEL_SUMMARY,
+  LABEL_SET_POWER,
+  LABEL_SET_DENSITY,
+  LABEL_SET_WEIGHT,
+  LABEL_SET_MOHS,
+  LABEL_SET_UNITS,
+  LABEL_SET_AGG_SIZE,
+  LABEL_POWER_STD,
+  LABEL_POWER_LOW,
+  LABEL_POWER_HIGH,
+  LABEL_DENSITY_STD,
+  LABEL_DENSITY_LIGHT,
+  LABEL_MOH_3,
+  LABEL_MOH_4,
+  LABEL_MOH_5,
+  LABEL_MOH_6,
+  LABEL_MOH_7,
+  LABEL_UNITS_MPA,
+  LABEL_UNITS_PSI,
+  LABEL_AGG_SIZE_MED,
+  LABEL_AGG_SIZE_SMALL_MPA,
+  LABEL_AGG_SIZE_LARGE_MPA,
+  LABEL_WEIGHT_HIGH_MPA,
+  LABEL_WEIGHT_MED_MPA,
+  LABEL_WEIGHT_LOW_MPA,
+  LABEL_AGG_SIZE_SMALL_PSI,
+  LABEL_AGG_SIZE_LARGE_PSI,
+  LABEL_WEIGHT_HIGH_PSI,
+  LABEL_WEIGHT_MED_PSI,
+  LABEL_WEIGHT_LOW_PSI,
+  LABEL_AVERAGE,
+  LABEL_CLEAR_TESTS,
+  LABEL_CONNECT_PC,
+  LABEL_DEVIATION,
+  LABEL_EEPROM_ERROR,
+  LABEL_ENTER_YES_ESC_NO,
+  LABEL_ENTIRE_TEST,
+  LABEL_ERROR_REPEAT,
+  LABEL_GO_TO_DATE,
+  LABEL_MAX_PRESS_ENTER,
+  LABEL_MAXIMUM,
+  LABEL_MEMORY_FULL,
+  LABEL_MINIMUM,
+  LABEL_PERF_ADC,
+  LABEL_PERF_EEPROM_READ,
+  LABEL_PERF_EEPROM_WRITE,
+  LABEL_PERF_LCD,
+  LABEL_PERF_MAIN_LOOP,
+  LABEL_PERF_RTC,
+  LABEL_PLEASE_WAIT,
+  LABEL_SENDING,
+  LABEL_TEST_NO,
+  LABEL_TEST_NO_SHOT,
+  LABEL_ZERO_PRESS_ENTER,
+  LABEL_COUNT
+};
+
+// Menu states
+enum
+{
+  MENU_STATE_BROWSE,                              // The main menu is showing
+  MENU_STATE_ENTER,                               // menuLocationNum must initialize
+  MENU_STATE_ACTIVE                               // menuLocationNum is running
+};
+
+// Set Settings states: indexes into SETTING_TABLE
+enum
+{
+  SETTING_POWER,
+  SETTING_DENSITY,
+  SETTING_WEIGHT,
+  SETTING_MOHS,
+  SETTING_UNITS,
+  SETTING_AGG_SIZE,
+  SETTING_COUNT                                   // All settings are set
+};
+
+// Calibrate states
+enum
+{
+  CAL_STATE_START,
+  CAL_STATE_ZERO,
+  CAL_STATE_FULL_SCALE
+};
+
+// Download Tests states
+enum
+{
+  DOWNLOAD_STATE_CONNECT,
+  DOWNLOAD_STATE_CLEAR
+};
+
+// Peripheral_sendRecords() modes
+enum
+{
+  SEND_MODE_DOWNLOAD,                             // Tests, counting the PC's DOWNLOAD_ACKs
+  SEND_MODE_RECORDS,                              // Tests, for COMMAND_RECORDS and COMMAND_SINCE
+  SEND_MODE_DELTAS                                // Delta Tests, for COMMAND_DELTAS
+};
+
+// Performance counters: indexes into perfCounters
+enum
+{
+  PERF_ADC,                                       // Peripheral_getADC()
+  PERF_EEPROM_READ,                               // Peripheral_readEEPROM*()
+  PERF_EEPROM_WRITE,                              // Peripheral_writeEEPROM*()
+  PERF_LCD,                                       // LCD_updateDisplay()
+  PERF_MAIN_LOOP,                                 // One pass of the main loop
+  PERF_RTC,                                       // Peripheral_readRTC()
+  PERF_COUNT
+};
+
+// Save states: the part of the queued test Peripheral_writeData() writes next
+enum
+{
+  SAVE_STATE_IDLE,                                // Nothing to write
+  SAVE_STATE_RECORD,                              // saveRecord is to be written
+  SAVE_STATE_COUNT,                               // testSetCount is to be written
+  SAVE_STATE_STATS                                // The statistics are to be updated
+};
+
+// Summary views: the statistic the Summary screen shows, stepped by Enter
+enum
+{
+  SUMMARY_VIEW_AVERAGE,
+  SUMMARY_VIEW_MINIMUM,
+  SUMMARY_VIEW_MAXIMUM,
+  SUMMARY_VIEW_DEVIATION,
+  SUMMARY_VIEW_COUNT
+};
+
+// Run Test states
+enum
+{
+  TEST_STATE_SHOOT,                               // Taking shot dataTestNumber
+  TEST_STATE_RESHOOT,                             // Repeating shot dataTestNumber
+  TEST_STATE_OK                                   // The shots passed the check
+};
+
 //******************************************************************************
 //  Constants
 //******************************************************************************
+const int32 DISPLAY_POWERS[DISPLAY_DIGITS] = {10000, 1000, 100, 10, 1};
+
+// All fixed text is streamed from ROM to the LCD by LCD_showLabel()
+const char LABEL_TEXT[LABEL_COUNT][*] =
+{
+  "",
+  "Measure",
+  "Run Test",
+  "Show Tests",
+  "Download Tests",
+  "Enter Setup",
+  "Show Settings",
+  "Set Settings",
+  "Set Clock",
+  "Calibrate",
+  "Diagnostics",
+  "Summary",
+  "Set Power",
+  "Set Density",
+  "Set Weight",
+  "Set Mohs",
+  "Set Units",
+  "Set Aggr Size",
+  "Std Power",
+  "Low Power",
+  "High Perf",
+  "Std Wght ",
+  "Lgt Wght ",
+  "MOH#3 ",
+  "MOH#4 ",
+  "MOH#5 ",
+  "MOH#6 ",
+  "MOH#7 ",
+  "MPa",
+  "PSI",
+  "Mrtr-M",
+  "25mm-S",
+  "50mm-L",
+  ">.83-h ",
+  ".83-79m",
+  "<.79-l ",
+  "1in.-S",
+  "2in.-L",
+  ">120-h ",
+  "115-20m",
+  "<115-l ",
+  "Ave",
+  "Clear Tests?",
+  "Connect PC",
+  "SD",
+  "EEPROM Error",
+  "Enter-YES ESC-NO",
+  "Entire Test",
+  "Error - Repeat",
+  "Go To Date",
+  "Max Press Enter",
+  "Max",
+  "Memory Full",
+  "Min",
+  "ADC",
+  "EE Read",
+  "EE Write",
+  "LCD",
+  "Loop",
+  "RTC",
+  "Please Wait",
+  "Sending",
+  "Test No.",
+  "Test No:",
+  "Zero Press Enter"
+};
+
+// Submenu setting labels by units (MPa, PSI) and SUBMENU_* value
+const byte SETTING_LABEL[2][SUBMENU_WEIGHT_SUPER_LOW + 1] =
+{
+  {
+    LABEL_NONE,
+    LABEL_POWER_STD,  LABEL_POWER_LOW, LABEL_POWER_HIGH,
+    LABEL_DENSITY_STD, LABEL_DENSITY_LIGHT,
+    LABEL_MOH_3, LABEL_MOH_4, LABEL_MOH_5, LABEL_MOH_6, LABEL_MOH_7,
+    LABEL_UNITS_MPA, LABEL_UNITS_PSI,
+    LABEL_AGG_SIZE_MED, LABEL_AGG_SIZE_SMALL_MPA, LABEL_AGG_SIZE_LARGE_MPA,
+    LABEL_WEIGHT_HIGH_MPA, LABEL_WEIGHT_MED_MPA, LABEL_WEIGHT_LOW_MPA, LABEL_NONE
+  },
+  {
+    LABEL_NONE,
+    LABEL_POWER_STD,  LABEL_POWER_LOW, LABEL_POWER_HIGH,
+    LABEL_DENSITY_STD, LABEL_DENSITY_LIGHT,
+    LABEL_MOH_3, LABEL_MOH_4, LABEL_MOH_5, LABEL_MOH_6, LABEL_MOH_7,
+    LABEL_UNITS_MPA, LABEL_UNITS_PSI,
+    LABEL_AGG_SIZE_MED, LABEL_AGG_SIZE_SMALL_PSI, LABEL_AGG_SIZE_LARGE_PSI,
+    LABEL_WEIGHT_HIGH_PSI, LABEL_WEIGHT_MED_PSI, LABEL_WEIGHT_LOW_PSI, LABEL_NONE
+  }
+};
+
+// Delta Tests: a test sent by COMMAND_DELTAS starts with a flags byte.  Bit n
+// is set if the fields from DELTA_FIELDS[n] up to DELTA_FIELDS[n + 1] differ
+// from the test before, and only those fields follow, then the shots.
+const byte DELTA_FIELDS[DELTA_GROUPS + 1] =
+{
+  RECORD_MINUTES, RECORD_HOURS, RECORD_DAY, RECORD_POWER, RECORD_ZERO, RECORD_SHOTS
+};
+
+// Diagnostics labels by PERF_* value
+const byte PERF_LABEL[PERF_COUNT] =
+{
+  LABEL_PERF_ADC, LABEL_PERF_EEPROM_READ, LABEL_PERF_EEPROM_WRITE,
+  LABEL_PERF_LCD, LABEL_PERF_MAIN_LOOP, LABEL_PERF_RTC
+};
+
+// Summary view labels by SUMMARY_VIEW_* value
+const byte SUMMARY_LABEL[SUMMARY_VIEW_COUNT] =
+{
+  LABEL_AVERAGE, LABEL_MINIMUM, LABEL_MAXIMUM, LABEL_DEVIATION
+};
 
 //******************************************************************************
 //  Structures
 //******************************************************************************
 
+// Menu descriptor.  The children of a menu are the entries whose parent is
+// that menu, in keyCount order from keyMin.
+typedef struct
+{
+  byte              label;
+  byte              parent;
+  byte              keyMin;
+  byte              keyMax;
+} MenuDescriptor;
+
+const MenuDescriptor MENU_TABLE[MENU_COUNT] =
+{
+  {LABEL_NONE,           MENU_MAIN,        MENU_MEASURE,     MENU_ENTER_SETUP     },
+  {LABEL_MEASURE,        MENU_MAIN,        0,                0                    },
+  {LABEL_RUN_TEST,       MENU_MAIN,        0,                0                    },
+  {LABEL_SHOW_TESTS,     MENU_MAIN,        1,                TEST_MAX_SETS        },
+  {LABEL_DOWNLOAD_TESTS, MENU_MAIN,        0,                0                    },
+  {LABEL_ENTER_SETUP,    MENU_MAIN,        SUBMENU_SET_SHOW, SUBMENU_SET_SUMMARY  },
+  {LABEL_SHOW_SETTINGS,  MENU_ENTER_SETUP, 0,                0                    },
+  {LABEL_SET_SETTINGS,   MENU_ENTER_SETUP, 0,                0                    },
+  {LABEL_SET_CLOCK,      MENU_ENTER_SETUP, 1,                12                   },
+  {LABEL_CALIBRATE,      MENU_ENTER_SETUP, 0,                0                    },
+  {LABEL_DIAGNOSTICS,    MENU_ENTER_SETUP, 0,                PERF_COUNT - 1       },
+  {LABEL_SUMMARY,        MENU_ENTER_SETUP, SUBMENU_POWER_STD, SUBMENU_POWER_HIGH  }
+};
+
+// Settings and calibration a reading is shown with.  The first SETTINGS_SIZE
+// bytes are in the order of EEPROM_POWER to EEPROM_FULL_SCALE and RECORD_POWER
+// to RECORD_FULL_SCALE.  The rest are set by Config_updateScaling().
+typedef struct
+{
+  byte              power;
+  byte              density;
+  byte              weight;
+  byte              mohs;
+  byte              units;
+  byte              aggSize;
+  byte              zero;
+  byte              fullScale;
+  long              scale;
+  byte              aggSizeLimit;
+  int32             distanceMult;
+  byte              pressureMult;
+} Settings;
+
+// Performance counter: the number of timings and their longest and total
+// Timer1 ticks
+typedef struct
+{
+  long              count;
+  long              max;
+  int32             total;
+} PerfCounter;
+
+// Statistics of the strengths (in 0.1 MPa) of the stored tests with one power
+// setting.  The blocks are kept up to date by Peripheral_writeData() and
+// rebuilt from the tests by Config_rebuildStatistics() when they don't agree
+// with them.
+typedef struct
+{
+  byte              count;
+  byte              check;                        // See Config_checkStatistics()
+  long              low;
+  long              high;
+  int32             sum;
+  int32             squares;
+  long              spare;                        // Pads to STATS_SIZE
+} Statistics;
+
+// Setting descriptor: keyCount range, the values used when the stored setting
+// is below keyMin or above keyLimit, and the transition taken when Enter is
+// pressed.  keyLimit is keyMax except for Weight, which keeps a stored Super
+// Low although the keys don't reach it.  The next setting is branchNext when
+// the value is branchValue, otherwise next.
+typedef struct
+{
+  byte              label;
+  byte              keyMin;
+  byte              keyMax;
+  byte              keyLimit;
+  byte              keyBelow;
+  byte              keyAbove;
+  byte              next;
+  byte              branchValue;
+  byte              branchNext;
+} SettingDescriptor;
+
+const SettingDescriptor SETTING_TABLE[SETTING_COUNT] =
+{
+  {LABEL_SET_POWER,    SUBMENU_POWER_STD,    SUBMENU_POWER_HIGH,     SUBMENU_POWER_HIGH,       SUBMENU_POWER_STD,      SUBMENU_POWER_STD,      SETTING_DENSITY,  SUBMENU_POWER_HIGH,    SETTING_UNITS },
+  {LABEL_SET_DENSITY,  SUBMENU_DENSITY_STD,  SUBMENU_DENSITY_LIGHT,  SUBMENU_DENSITY_LIGHT,    SUBMENU_DENSITY_STD,    SUBMENU_DENSITY_STD,    SETTING_MOHS,     SUBMENU_DENSITY_LIGHT, SETTING_WEIGHT},
+  {LABEL_SET_WEIGHT,   SUBMENU_WEIGHT_HIGH,  SUBMENU_WEIGHT_LOW,     SUBMENU_WEIGHT_SUPER_LOW, SUBMENU_WEIGHT_MED,     SUBMENU_WEIGHT_MED,     SETTING_UNITS,    0,                     0             },
+  {LABEL_SET_MOHS,     SUBMENU_MOH_3,        SUBMENU_MOH_7,          SUBMENU_MOH_7,            SUBMENU_MOH_4,          SUBMENU_MOH_4,          SETTING_UNITS,    0,                     0             },
+  {LABEL_SET_UNITS,    SUBMENU_UNITS_MPA,    SUBMENU_UNITS_PSI,      SUBMENU_UNITS_PSI,        SUBMENU_UNITS_MPA,      SUBMENU_UNITS_PSI,      SETTING_AGG_SIZE, 0,                     0             },
+  {LABEL_SET_AGG_SIZE, SUBMENU_AGG_SIZE_MED, SUBMENU_AGG_SIZE_LARGE, SUBMENU_AGG_SIZE_LARGE,   SUBMENU_AGG_SIZE_SMALL, SUBMENU_AGG_SIZE_SMALL, SETTING_COUNT,    0,                     0             }
+};
+
 //******************************************************************************
 //  Prototypes (Global)
 //******************************************************************************
 #use                                    DELAY(clock = 4000000)
 #use                                    fixed_io(b_outputs = pin_b2, pin_b3)
 #use                                    i2c(MASTER, sda = PIN_C4, scl = PIN_C3, SLOW, FORCE_SW)
-#use                                    rs232(baud = 9600, xmit = PIN_C6, rcv = PIN_C7, brgh1ok)
+#use                                    rs232(baud = 9600, xmit = PIN_C6, rcv = PIN_C7, brgh1ok, errors)
 
 // Config
+void                                    Config_addStatistics(byte *record);
+void                                    Config_addStrength(Statistics *s, long strength);
+byte                                    Config_checkStatistics(void);
+byte                                    Config_getMenuChild(byte parent);
 void                                    Config_initialize(void);
 void                                    Config_loadSetup(void);
+short int                               Config_loadStatistics(byte group);
+void                                    Config_rebuildStatistics(void);
 void                                    Config_saveSetup(void);
+void                                    Config_saveSettings(void);
+void                                    Config_saveStatistics(byte group);
 void                                    Config_setSettings(void);
+void                                    Config_updateScaling(Settings *s);
+
+// Diagnostic
+void                                    Diagnostic_addTime(byte counter, long start);
+void                                    Diagnostic_clearCounters(void);
+void                                    Diagnostic_sendCounters(void);
 
 // Display
+int32                                   Display_calculateDistance(signed long reading, byte zero, long scale);
+int32                                   Display_calculatePressure(int32 length, byte power, byte mohs, byte weight);
+long                                    Display_calculateRoot(int32 value);
+long                                    Display_calculateScale(byte zero, byte fullScale);
+long                                    Display_calculateStrength(byte *record);
+#ifdef AUTO_ADVANCE
+short int                               Display_checkShot(void);
+#endif
+void                                    Display_checkTable(void);
 void                                    Display_checkTestData(void);
 /*#separate*/ int32                   Display_doCalculation(float x);
-void                                    Display_showData(void);
+byte                                    Display_findOutlier(byte limit);
+void                                    Display_packDigits(byte position);
+void                                    Display_showData(Settings *s);
 void                                    Display_showDecimal(int data);
-void                                    Display_showDistance(void);
+void                                    Display_showDistance(Settings *s);
 void                                    Display_showMenuDownloadTests(void);
 void                                    Display_showMenuEnterSetup(void);
 void                                    Display_showMenuMeasure(void);
 void                                    Display_showMenuRunTest(void);
 void                                    Display_showMenuShowTests(void);
-void                                    Display_showPressure(void);
+void                                    Display_showNumber(int32 value, byte digits, byte point);
+void                                    Display_showPressure(Settings *s);
 void                                    Display_showSubmenuCalibrate(void);
+void                                    Display_showSubmenuDiagnostics(void);
 void                                    Display_showSubmenuSetClock(void);
 void                                    Display_showSubmenuSetSettings(byte data);
 void                                    Display_showSubmenuShowSettings(void);
+void                                    Display_showSubmenuSummary(void);
+void                                    Display_showTableDigits(byte digits, byte point);
 void                                    Display_showTime(void);
-void                                    Display_updateDisplayPressure(int32 pressure);
+void                                    Display_updateDisplayPressure(Settings *s, int32 pressure);
 
 // Keyboard
 void                                    Keyboard_getDownKey(void);
@@ -206,23 +741,41 @@ void                                    Keyboard_getUpKey(void);
 void                                    LCD_clearDisplay(void);
 void                                    LCD_setCursorPosition(byte row, byte col);
 void                                    LCD_turnOffCursor(void);
+void                                    LCD_showLabel(byte label);
 void                                    LCD_turnOnCursor(void);
 void                                    LCD_updateDisplay(void);
 void                                    LCD_waitForReadySignal(void);
+void                                    LCD_writeData(byte data);
 
 // Main
 void                                    main(void);
 
 // Peripheral
+void                                    Peripheral_addressEEPROM(void);
+short int                               Peripheral_checkEEPROM(void);
+byte                                    Peripheral_findRecord(int32 stamp);
+void                                    Peripheral_flushData(void);
+void                                    Peripheral_flushUART(void);
 void                                    Peripheral_getADC(void);
+int32                                   Peripheral_packTime(byte *time);
+void                                    Peripheral_putUART(byte data);
+void                                    Peripheral_readCommand(void);
 byte                                    Peripheral_readEEPROM(void);
+void                                    Peripheral_readEEPROMBlock(byte *data, byte count);
+void                                    Peripheral_readRecord(byte test, byte *data);
+void                                    Peripheral_readRecordTimes(byte first, byte count, byte *data);
 void                                    Peripheral_readRTC(void);
+short int                               Peripheral_readUART(byte *data);
+void                                    Peripheral_readUploadAck(void);
 void                                    Peripheral_saveData(void);
-void                                    Peripheral_scaleADC(void);
+void                                    Peripheral_sendRecords(byte first, byte last, byte mode);
 void                                    Peripheral_setRTC(void);
 //void                                    Peripheral_startI2C(void);
 //void                                    Peripheral_stopI2C(void);
+void                                    Peripheral_transmitUART(void);
+void                                    Peripheral_writeData(void);
 void                                    Peripheral_writeEEPROM(byte data);
+void                                    Peripheral_writeEEPROMBlock(byte *data, byte count);
 
 #ifdef DEBUG
 #inline
@@ -0,0 +1,343 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: callgraph.py
+#
+#  Description:
+#  ============
+#  Static call graph report for the Windsor firmware.  It parses Windsor.c
+#  (and the numeric #defines in Windsor.h) and prints, for main(), the
+#  interrupt handlers and every menu handler:
+#
+#    - the worst case call depth and its path, against the 16F77's 8 level
+#      hardware stack.  Depth is given as written and with the functions
+#      that have a single call site inlined, which CCS does unless they are
+#      marked #separate; functions marked #inline never take a level.  CCS
+#      library routines (i2c, delays, rs232) count as one more level.  An
+#      interrupt can arrive at the deepest point, so the deepest handler is
+#      added on top.
+#    - a size estimate: the number of statements reachable from the handler.
+#    - a worst case bound of the statements run and the delay_ms()/delay_us()
+#      time spent, with each loop counted at its constant bound.  Loops
+#      without a constant bound are counted once and marked with "+".
+#
+#  The numbers are estimates from the source; the .lst, .sta and .tre files
+#  from the compiler remain the final word.
+#
+#  Usage: tools/callgraph.py [Windsor.c] [-v]
+#
+#******************************************************************************
+import os
+import re
+import sys
+
+STACK_LEVELS = 8
+
+# CCS library routines that are called rather than expanded in line
+LIBRARY_CALLS = {
+  "delay_ms", "delay_us", "getc", "i2c_read", "i2c_start", "i2c_stop",
+  "i2c_write", "printf", "putc", "read_adc",
+}
+
+HANDLER_PREFIXES = ("Display_showMenu", "Display_showSubmenu", "Config_setSettings")
+
+
+#******************************************************************************
+#
+#  Function: load_defines()
+#
+#  Description:
+#  ============
+#  Returns the #defines of the header that are plain numbers.
+#
+#******************************************************************************
+def load_defines(path):
+  defines = {}
+  if not os.path.exists(path):
+    return defines
+  for line in open(path, errors="replace"):
+    match = re.match(r"\s*#define\s+(\w+)\s+(0x[0-9a-fA-F]+|\d+)\b", line)
+    if match:
+      defines[match.group(1)] = int(match.group(2), 0)
+  return defines
+
+
+#******************************************************************************
+#
+#  Function: strip_source()
+#
+#  Description:
+#  ============
+#  Blanks out comments, strings and character constants, keeping the offsets
+#  so the brace matching below stays simple.
+#
+#******************************************************************************
+def strip_source(text):
+  def blank(match):
+    return re.sub(r"[^\n]", " ", match.group(0))
+  return re.sub(r'//[^\n]*|/\*.*?\*/|"(?:\\.|[^"\\])*"|\'(?:\\.|[^\'\\])*\'',
+                blank, text, flags=re.S)
+
+
+#******************************************************************************
+#
+#  Function: find_close()
+#
+#  Description:
+#  ============
+#  Returns the offset just past the bracket that closes the one at "start".
+#
+#******************************************************************************
+def find_close(text, start, open_char, close_char):
+  depth = 0
+  for i in range(start, len(text)):
+    if text[i] == open_char:
+      depth += 1
+    elif text[i] == close_char:
+      depth -= 1
+      if depth == 0:
+        return i + 1
+  return len(text)
+
+
+#******************************************************************************
+#
+#  Function: find_loops()
+#
+#  Description:
+#  ============
+#  Returns (start, end, bound) for each for/while loop in the body, where
+#  bound is None if it isn't a constant.
+#
+#******************************************************************************
+def find_loops(body, defines):
+  loops = []
+  for match in re.finditer(r"\b(for|while)\s*\(", body):
+    header_end = find_close(body, match.end() - 1, "(", ")")
+    header = body[match.end():header_end - 1]
+    rest = body[header_end:]
+    lead = len(rest) - len(rest.lstrip())
+    if rest.lstrip().startswith("{"):
+      end = find_close(body, header_end + lead, "{", "}")
+    elif rest.lstrip().startswith(";"):
+      # do { } while (); is counted by its do
+      continue
+    else:
+      end = body.find(";", header_end) + 1
+    bound = None
+    if match.group(1) == "for":
+      parts = header.split(";")
+      if len(parts) == 3:
+        limit = re.search(r"<\s*=?\s*([\w\s\+\-\*/\(\)]+)$", parts[1].strip())
+        if limit:
+          try:
+            bound = eval(re.sub(r"\b[A-Za-z_]\w*\b",
+                                lambda m: str(defines[m.group(0)]), limit.group(1)))
+            bound = int(bound)
+          except (KeyError, SyntaxError, TypeError):
+            bound = None
+    loops.append((match.start(), end, bound))
+  return loops
+
+
+#******************************************************************************
+#
+#  Function: parse_functions()
+#
+#  Description:
+#  ============
+#  Returns a dictionary of the functions defined in the source.  Each entry
+#  holds its call sites (callee, loop multiplier, bounded), its statement
+#  count, its delay time in microseconds and whether it is an interrupt.
+#
+#******************************************************************************
+def parse_functions(text, defines):
+  functions = {}
+  pattern = re.compile(r"^(#\w+\s*\n)?[A-Za-z_][\w \*]*?\b(\w+)\s*\([^;{}]*\)\s*\{", re.M)
+  for match in pattern.finditer(text):
+    name = match.group(2)
+    if name in ("if", "while", "for", "switch"):
+      continue
+    start = match.end() - 1
+    end = find_close(text, start, "{", "}")
+    directive = (match.group(1) or "").strip().lower()
+    functions[name] = {
+      "body": text[start:end],
+      "directive": directive,
+      "interrupt": directive.startswith("#int_"),
+    }
+
+  for name, function in functions.items():
+    body = function["body"]
+    loops = find_loops(body, defines)
+
+    def multiplier(position):
+      total = 1
+      bounded = True
+      for start, end, bound in loops:
+        if start <= position < end:
+          if bound is None:
+            bounded = False
+          else:
+            total *= bound
+      return total, bounded
+
+    calls = []
+    delay = 0
+    delay_bounded = True
+    for call in re.finditer(r"\b(\w+)\s*\(", body):
+      callee = call.group(1)
+      if callee in functions and callee != name:
+        total, bounded = multiplier(call.start())
+        calls.append((callee, total, bounded))
+      elif callee in ("delay_ms", "delay_us"):
+        argument = body[call.end():find_close(body, call.end() - 1, "(", ")") - 1]
+        total, bounded = multiplier(call.start())
+        try:
+          value = int(eval(re.sub(r"\b[A-Za-z_]\w*\b",
+                                  lambda m: str(defines[m.group(0)]), argument)))
+        except (KeyError, SyntaxError, TypeError):
+          value = 0
+          bounded = False
+        delay += value * total * (1000 if callee == "delay_ms" else 1)
+        delay_bounded = delay_bounded and bounded
+    statements = 0
+    statements_bounded = True
+    for semicolon in re.finditer(";", body):
+      total, bounded = multiplier(semicolon.start())
+      statements += total
+      statements_bounded = statements_bounded and bounded
+    function["calls"] = calls
+    function["library"] = any(re.search(r"\b%s\s*\(" % routine, body) for routine in LIBRARY_CALLS)
+    function["statements"] = body.count(";")
+    function["work"] = (statements, statements_bounded)
+    function["delay"] = (delay, delay_bounded)
+  return functions
+
+
+#******************************************************************************
+#
+#  Function: call_depth()
+#
+#  Description:
+#  ============
+#  Returns (levels, path) of the deepest call chain below the function.  With
+#  "inline" set, functions with one call site don't take a stack level.
+#
+#******************************************************************************
+def call_depth(functions, name, inline, sites, seen=()):
+  function = functions[name]
+  if function["directive"] == "#inline":
+    own = 0
+  elif function["directive"] == "#separate":
+    own = 1
+  else:
+    own = 0 if (inline and sites.get(name, 0) == 1) else 1
+  if name in seen:
+    return STACK_LEVELS * 2, [name + " (recursive)"]
+  best = (1 if function["library"] else 0, [])
+  for callee, _, _ in function["calls"]:
+    levels, path = call_depth(functions, callee, inline, sites, seen + (name,))
+    if levels > best[0]:
+      best = (levels, path)
+  return best[0] + own, [name] + best[1]
+
+
+#******************************************************************************
+#
+#  Function: total_cost()
+#
+#  Description:
+#  ============
+#  Returns the bounded statements, the delay in microseconds and whether
+#  both bounds hold, for the function and everything it calls.
+#
+#******************************************************************************
+def total_cost(functions, name, memo, seen=()):
+  if name in memo:
+    return memo[name]
+  function = functions[name]
+  statements, statements_bounded = function["work"]
+  delay, delay_bounded = function["delay"]
+  bounded = statements_bounded and delay_bounded
+  for callee, times, call_bounded in function["calls"]:
+    if callee in seen:
+      bounded = False
+      continue
+    callee_statements, callee_delay, callee_bounded = total_cost(functions, callee, memo, seen + (name,))
+    statements += times * callee_statements
+    delay += times * callee_delay
+    bounded = bounded and call_bounded and callee_bounded
+  memo[name] = (statements, delay, bounded)
+  return memo[name]
+
+
+#******************************************************************************
+#
+#  Function: reachable()
+#
+#  Description:
+#  ============
+#  Returns the set of functions called directly or indirectly.
+#
+#******************************************************************************
+def reachable(functions, name, found=None):
+  found = set() if found is None else found
+  if name not in found:
+    found.add(name)
+    for callee, _, _ in functions[name]["calls"]:
+      reachable(functions, callee, found)
+  return found
+
+
+def main():
+  arguments = [argument for argument in sys.argv[1:] if not argument.startswith("-")]
+  verbose = "-v" in sys.argv[1:]
+  source = arguments[0] if arguments else os.path.join(os.path.dirname(__file__), "..", "Windsor.c")
+  defines = load_defines(os.path.splitext(source)[0] + ".h")
+  functions = parse_functions(strip_source(open(source, errors="replace").read()), defines)
+
+  sites = {}
+  for function in functions.values():
+    for callee, _, _ in function["calls"]:
+      sites[callee] = sites.get(callee, 0) + 1
+
+  interrupts = [name for name, function in functions.items() if function["interrupt"]]
+  interrupt_levels = 0
+  for name in interrupts:
+    interrupt_levels = max(interrupt_levels, call_depth(functions, name, False, sites)[0])
+
+  handlers = ["main"] + sorted(name for name in functions if name.startswith(HANDLER_PREFIXES)) + interrupts
+  memo = {}
+  print("%-34s %5s %6s %6s %8s %10s" % ("Function", "Depth", "Inline", "+Int", "Stmts", "Delay ms"))
+  worst = 0
+  for name in handlers:
+    if name not in functions:
+      continue
+    written, path = call_depth(functions, name, False, sites)
+    inlined, _ = call_depth(functions, name, True, sites)
+    if name == "main":
+      written -= 1                                # main is jumped to, not called
+      inlined -= 1
+    if name in interrupts:
+      stacked = written
+    else:
+      stacked = inlined + interrupt_levels
+    worst = max(worst, stacked)
+    statements, delay, bounded = total_cost(functions, name, memo)
+    print("%-34s %5d %6d %5d%s %7d%s %9.1f%s" % (
+      name, written, inlined, stacked, "!" if stacked > STACK_LEVELS else " ",
+      statements, " " if bounded else "+", delay / 1000.0, " " if bounded else "+"))
+    if verbose:
+      print("    " + " -> ".join(path))
+
+  print()
+  print("Size estimate (statements reachable from main): %d of %d in %d functions" % (
+    sum(functions[name]["statements"] for name in reachable(functions, "main")),
+    sum(function["statements"] for function in functions.values()), len(functions)))
+  print("Worst stack use with an interrupt: %d of %d levels" % (worst, STACK_LEVELS))
+  return 1 if worst > STACK_LEVELS else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
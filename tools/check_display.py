@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: check_display.py
+#
+#  Description:
+#  ============
+#  Host check of the Measure display.  Before the per-calibration constants
+#  were cached, Display_showDistance() and Display_updateDisplayPressure()
+#  divided through a 10000/1000/100 cascade and converted inches with a float
+#  multiply.  This renders both with the old firmware and the current one,
+#  with its display table off, and compares the text:
+#
+#    - the distance for every ADC reading and every zero and full scale pair
+#      (zero <= reading, zero + 1 < full scale), in both units
+#    - the pressure from 0 to 6000 (0.1 MPa) in both units
+#
+#  The old code kept the scaled distance in 16 bits, so it wrapped above
+#  65.5 mm and, in inches, above about 166 mm.  Those readings are past what
+#  the three digits show; they are counted and not compared.
+#
+#  Usage: tools/check_display.py old-revision
+#    old-revision is any git revision that divides on every frame, such as
+#    the parent of the commit that added Config_updateScaling().
+#
+#******************************************************************************
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hostbuild
+
+PRESSURE_MAX = 6000
+
+# Each output record is the 8 characters shown and a flag for the old 16-bit
+# wrap
+OLD_DRIVER = r"""
+static void show(uint8_t wrapped)
+{
+  fwrite(lcdData, 1, 8, stdout);
+  putchar(wrapped);
+}
+
+int main(void)
+{
+  int               full, pressure, reading, units, zero;
+
+  for (units = SUBMENU_UNITS_MPA ; units <= SUBMENU_UNITS_PSI ; units++)
+  {
+    submenuUnits = units;
+    for (zero = 0 ; zero < 256 ; zero++)
+    for (full = zero + 2 ; full < 256 ; full++)
+    {
+      adcZero = zero;
+      adcFullScale = full;
+      Peripheral_scaleADC();
+      for (reading = zero ; reading < 256 ; reading++)
+      {
+        adcReading = reading;
+        Display_showDistance();
+        show((units == SUBMENU_UNITS_MPA) ? (distance * 10 >= 65536) : (distance * 3.937 >= 65536));
+      }
+    }
+    for (pressure = 0 ; pressure <= PRESSURE_MAX ; pressure++)
+    {
+      Display_updateDisplayPressure(pressure);
+      show(0);
+    }
+  }
+  return (0);
+}
+"""
+
+NEW_DRIVER = r"""
+static void show(void)
+{
+  fwrite(lcdData, 1, 8, stdout);
+  putchar(0);
+}
+
+int main(void)
+{
+  int               full, pressure, reading, units, zero;
+
+  tableReady = false;
+  for (units = SUBMENU_UNITS_MPA ; units <= SUBMENU_UNITS_PSI ; units++)
+  {
+    settings.units = units;
+    settings.aggSize = SUBMENU_AGG_SIZE_MED;
+    for (zero = 0 ; zero < 256 ; zero++)
+    for (full = zero + 2 ; full < 256 ; full++)
+    {
+      settings.zero = zero;
+      settings.fullScale = full;
+      Config_updateScaling(&settings);
+      for (reading = zero ; reading < 256 ; reading++)
+      {
+        adcReading = reading;
+        Display_showDistance(&settings);
+        show();
+      }
+    }
+    for (pressure = 0 ; pressure <= PRESSURE_MAX ; pressure++)
+    {
+      Display_updateDisplayPressure(&settings, pressure);
+      show();
+    }
+  }
+  return (0);
+}
+"""
+
+RECORD = 9
+
+
+#******************************************************************************
+#
+#  Function: cases()
+#
+#  Description:
+#  ============
+#  Yields a description of each record, in the order the drivers write them.
+#
+#******************************************************************************
+def cases():
+  for units in ("MPa", "psi"):
+    for zero in range(256):
+      for full in range(zero + 2, 256):
+        for reading in range(zero, 256):
+          yield "%s distance: reading %d, zero %d, full scale %d" % (units, reading, zero, full)
+    for pressure in range(PRESSURE_MAX + 1):
+      yield "%s pressure %d" % (units, pressure)
+
+
+def main():
+  if len(sys.argv) != 2:
+    print("Usage: %s old-revision" % sys.argv[0])
+    return 2
+  old_revision = sys.argv[1]
+  defines = ["PRESSURE_MAX %d" % PRESSURE_MAX]
+  old = subprocess.run([hostbuild.build(OLD_DRIVER, old_revision, defines)],
+                       check=True, stdout=subprocess.PIPE).stdout
+  new = subprocess.run([hostbuild.build(NEW_DRIVER, None, defines)],
+                       check=True, stdout=subprocess.PIPE).stdout
+  if len(old) != len(new):
+    print("The builds wrote %d and %d records" % (len(old) // RECORD, len(new) // RECORD))
+    return 1
+
+  wrapped = 0
+  differences = 0
+  for index, description in enumerate(cases()):
+    start = index * RECORD
+    if old[start + 8]:
+      wrapped += 1
+      continue
+    if old[start:start + 8] != new[start:start + 8]:
+      differences += 1
+      if differences <= 10:
+        print("%s: old \"%s\", new \"%s\"" % (description, old[start:start + 8].decode("latin-1"),
+                                               new[start:start + 8].decode("latin-1")))
+  print("%d displays compared, %d old readings wrapped, %d differences" % (
+    len(old) // RECORD - wrapped, wrapped, differences))
+  return 1 if differences else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: check_imperial.py
+#
+#  Description:
+#  ============
+#  Host check of the inches shown in Measure and Run Test.  The firmware
+#  converts the metric distance with the fixed-point DISTANCE_MULT_IMPERIAL
+#  in place of the float 3.937 of the old firmware.  For every calibration
+#  (zero + 1 < full scale) this builds the display table, as the probe does
+#  for all 256 ADC codes, and renders each code both from the table and
+#  directly.  Each text is compared with:
+#
+#    - the exact inches, distance * 3.937 truncated to 0.01 in., wherever
+#      the distance is not negative and fits the three digits
+#    - the old firmware, for the readings it rendered without a 16-bit wrap
+#      (reading >= zero and distance * 3.937 < 65536)
+#
+#  Usage: tools/check_imperial.py old-revision
+#    old-revision is any git revision with the float conversion, such as the
+#    parent of the commit that added Config_updateScaling().
+#
+#******************************************************************************
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hostbuild
+
+# Each output record is the 4 characters shown, "X.XX"
+OLD_DRIVER = r"""
+int main(void)
+{
+  int               full, reading, zero;
+
+  submenuUnits = SUBMENU_UNITS_PSI;
+  for (zero = 0 ; zero < 256 ; zero++)
+  for (full = zero + 2 ; full < 256 ; full++)
+  {
+    adcZero = zero;
+    adcFullScale = full;
+    Peripheral_scaleADC();
+    for (reading = 0 ; reading < 256 ; reading++)
+    {
+      adcReading = reading;
+      Display_showDistance();
+      fwrite(lcdData + 3, 1, 4, stdout);
+    }
+  }
+  return (0);
+}
+"""
+
+# Each output record is the table's 4 characters and then the direct ones
+NEW_DRIVER = r"""
+int main(void)
+{
+  int               full, reading, zero;
+
+  settings.power = SUBMENU_POWER_STD;
+  settings.density = SUBMENU_DENSITY_STD;
+  settings.weight = SUBMENU_WEIGHT_MED;
+  settings.mohs = SUBMENU_MOH_4;
+  settings.units = SUBMENU_UNITS_PSI;
+  settings.aggSize = SUBMENU_AGG_SIZE_MED;
+  for (zero = 0 ; zero < 256 ; zero++)
+  for (full = zero + 2 ; full < 256 ; full++)
+  {
+    settings.zero = zero;
+    settings.fullScale = full;
+    Config_updateScaling(&settings);
+    Display_checkTable();
+    for (reading = 0 ; reading < 256 ; reading++)
+    {
+      adcReading = reading;
+      tableReady = true;
+      Display_showDistance(&settings);
+      fwrite(lcdData + 3, 1, 4, stdout);
+      tableReady = false;
+      Display_showDistance(&settings);
+      fwrite(lcdData + 3, 1, 4, stdout);
+    }
+  }
+  return (0);
+}
+"""
+
+
+#******************************************************************************
+#
+#  Function: cases()
+#
+#  Description:
+#  ============
+#  Yields the zero, full scale and reading of each record, in the order the
+#  drivers write them.
+#
+#******************************************************************************
+def cases():
+  for zero in range(256):
+    for full in range(zero + 2, 256):
+      for reading in range(256):
+        yield zero, full, reading
+
+
+def main():
+  if len(sys.argv) != 2:
+    print("Usage: %s old-revision" % sys.argv[0])
+    return 2
+  old_revision = sys.argv[1]
+  old = subprocess.run([hostbuild.build(OLD_DRIVER, old_revision)],
+                       check=True, stdout=subprocess.PIPE).stdout
+  new = subprocess.run([hostbuild.build(NEW_DRIVER)], check=True, stdout=subprocess.PIPE).stdout
+  if 2 * len(old) != len(new):
+    print("The builds wrote %d and %d records" % (len(old) // 4, len(new) // 8))
+    return 1
+
+  compared = {"exact": 0, "old": 0}
+  differences = 0
+  scale = None
+  for index, (zero, full, reading) in enumerate(cases()):
+    if reading == 0:
+      scale = 3810 // (full - zero - 1)           # Display_calculateScale()
+    distance = 2540 + (reading - zero) * scale
+    table = new[index * 8:index * 8 + 4].decode("latin-1")
+    direct = new[index * 8 + 4:index * 8 + 8].decode("latin-1")
+    expected = {}
+    if distance >= 0 and distance * 3937 // 100000 < 1000:
+      exact = distance * 3937 // 100000
+      expected["exact"] = "%d.%02d" % (exact // 100, exact % 100)
+    if reading >= zero and distance * 3.937 < 65536:
+      expected["old"] = old[index * 4:index * 4 + 4].decode("latin-1")
+    for against, text in expected.items():
+      compared[against] += 1
+      if table == text and direct == text:
+        continue
+      differences += 1
+      if differences <= 10:
+        print("reading %d, zero %d, full scale %d: %s \"%s\", table \"%s\", direct \"%s\"" % (
+          reading, zero, full, against, text, table, direct))
+  print("%d readings compared with exact inches, %d with the old firmware, %d differences" % (
+    compared["exact"], compared["old"], differences))
+  return 1 if differences else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
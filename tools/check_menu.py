@@ -0,0 +1,465 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: check_menu.py
+#
+#  Description:
+#  ============
+#  Host check of the menu state machine.  Each case starts the firmware's
+#  main() from power-up with a number of stored tests, presses its keys one
+#  at a time, and compares the state after each key: the menu, its menuState,
+#  the screen's own state (the selected item, setting, calibration step,
+#  download step, shot, summary view or counter), the stored tests and the
+#  live settings.
+#
+#  The cases take every transition of the main menu, Enter Setup, Set
+#  Settings (each branch of SETTING_TABLE), Set Clock, Calibrate,
+#  Diagnostics, Summary, Run Test (including a repeated shot and a repeated
+#  test), Show Tests and Download Tests, and escape from every screen.  While
+#  escape is pressed the stored settings and calibration are changed, so a
+#  reload would show in the live ones.  Escape must reach the main menu
+#  without one.
+#
+#  Usage: tools/check_menu.py
+#
+#******************************************************************************
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hostbuild
+
+# Runs one case: the number of stored tests and then the keys, each DOWN, UP,
+# ENTER or ESC, or ADC=n to set the ADC reading for the keys after it.  A key
+# is held for HOLD_SCANS scans and the state is written SETTLE_SCANS scans
+# after its release, one line per key.  A scan is a call of hostYield, on each
+# key scan and UART poll, so the settle time outlasts the download's ACK
+# wait, which polls once a millisecond:
+#
+#   key | menu | menuState | screen state | tests=n | settings=... | calibration=...
+#
+# While ESC is pressed, the stored settings and calibration are swapped with
+# those in checkSetup[], until the state is written.
+DRIVER = r"""
+#include <unistd.h>
+
+#define HOLD_SCANS                      4
+#define SETTLE_SCANS                    (DOWNLOAD_ACK_WAIT + 40)
+
+static char         **checkKeys;
+static char         *checkKey = "start";
+static int          checkKeysLeft;
+static byte         checkSetup[8] = {SUBMENU_POWER_LOW, SUBMENU_DENSITY_LIGHT, SUBMENU_WEIGHT_MED,
+                                     SUBMENU_MOH_5, SUBMENU_UNITS_PSI, SUBMENU_AGG_SIZE_SMALL, 40, 230};
+static int          checkSwapped;
+static int          checkWait = SETTLE_SCANS;
+
+static const char   *MENU_STATE_NAMES[] = {"browse", "enter", "active"};
+static const char   *CAL_STATE_NAMES[] = {"start", "zero", "full scale"};
+static const char   *DOWNLOAD_STATE_NAMES[] = {"connect", "clear"};
+static const char   *TEST_STATE_NAMES[] = {"shoot", "reshoot", "ok"};
+
+
+// Writes a label without its trailing spaces
+static void checkLabel(byte label)
+{
+  int               length;
+
+  length = strlen(LABEL_TEXT[label]);
+  while (length && (LABEL_TEXT[label][length - 1] == ' '))
+  {
+    --length;
+  }
+  printf("%.*s", length, LABEL_TEXT[label]);
+}
+
+
+static void checkReport(void)
+{
+  printf("%s | ", checkKey);
+  if (menuLocationNum == MENU_MAIN)
+  {
+    printf("Main");
+  }
+  else
+  {
+    checkLabel(MENU_TABLE[menuLocationNum].label);
+  }
+  printf(" | %s | ", MENU_STATE_NAMES[menuState]);
+  if (menuState == MENU_STATE_BROWSE)
+  {
+    checkLabel(MENU_TABLE[Config_getMenuChild(MENU_MAIN)].label);
+  }
+  else if (menuState == MENU_STATE_ACTIVE)
+  {
+    switch (menuLocationNum)
+    {
+    case MENU_RUN_TEST:
+      printf("%s", TEST_STATE_NAMES[testState]);
+      if (testState != TEST_STATE_OK)
+      {
+        printf(" shot %d", dataTestNumber + 1);
+      }
+      break;
+    case MENU_SHOW_TESTS:
+      printf(showDate ? "date test %d" : "test %d step %d", keyCount, dataTestNumber);
+      break;
+    case MENU_DOWNLOAD_TESTS:
+      printf("%s", DOWNLOAD_STATE_NAMES[downloadState]);
+      break;
+    case MENU_ENTER_SETUP:
+      checkLabel(MENU_TABLE[Config_getMenuChild(MENU_ENTER_SETUP)].label);
+      break;
+    case MENU_SET_SETTINGS:
+      checkLabel(SETTING_TABLE[settingState].label);
+      break;
+    case MENU_SET_CLOCK:
+      printf("position %d", lcdPosition);
+      break;
+    case MENU_CALIBRATE:
+      printf("%s", CAL_STATE_NAMES[calState]);
+      break;
+    case MENU_DIAGNOSTICS:
+      printf("counter %d", keyCount);
+      break;
+    case MENU_SUMMARY:
+      printf("power %d ", keyCount);
+      checkLabel(SUMMARY_LABEL[summaryView]);
+      break;
+    }
+  }
+  printf(" | tests=%d | settings=%d %d %d %d %d %d | calibration=%d %d\n", testSetCount,
+         settings.power, settings.density, settings.weight, settings.mohs, settings.units,
+         settings.aggSize, settings.zero, settings.fullScale);
+}
+
+
+// Swaps the stored settings and calibration with checkSetup[]
+static void checkSwapSetup(void)
+{
+  byte              i;
+  byte              value;
+
+  for (i = 0 ; i < sizeof(checkSetup) ; i++)
+  {
+    value = hostEeprom[EEPROM_POWER + i];
+    hostEeprom[EEPROM_POWER + i] = checkSetup[i];
+    checkSetup[i] = value;
+  }
+}
+
+
+// Presses the keys, one per call once the last one has settled
+static void checkScan(void)
+{
+  if (checkWait)
+  {
+    --checkWait;
+    return;
+  }
+  if (hostKey)
+  {
+    hostKey = 0;
+    checkWait = SETTLE_SCANS;
+    return;
+  }
+
+  if (checkKey)
+  {
+    checkReport();
+    checkKey = NULL;
+  }
+  if (checkSwapped)
+  {
+    checkSwapSetup();
+    checkSwapped = false;
+  }
+  if (!checkKeysLeft)
+  {
+    exit(0);
+  }
+  checkKey = *checkKeys++;
+  --checkKeysLeft;
+  if (!strncmp(checkKey, "ADC=", 4))
+  {
+    hostAdc = atoi(checkKey + 4);
+    checkKey = NULL;
+    checkWait = SETTLE_SCANS;
+    return;
+  }
+  hostKey = !strcmp(checkKey, "DOWN") ? DOWN_KEY : !strcmp(checkKey, "UP") ? UP_KEY :
+            !strcmp(checkKey, "ENTER") ? ENTER_KEY : !strcmp(checkKey, "ESC") ? ESC_KEY : 0;
+  if (!hostKey)
+  {
+    printf("bad key %s\n", checkKey);
+    exit(1);
+  }
+  if (hostKey == ESC_KEY)
+  {
+    checkSwapSetup();
+    checkSwapped = true;
+  }
+  checkWait = HOLD_SCANS;
+}
+
+
+int main(int argc, char **argv)
+{
+  int               i;
+  int               tests;
+
+  alarm(10);
+  memset(hostEeprom, 0xff, sizeof(hostEeprom));
+  hostEeprom[EEPROM_POWER] = SUBMENU_POWER_STD;
+  hostEeprom[EEPROM_DENSITY] = SUBMENU_DENSITY_STD;
+  hostEeprom[EEPROM_WEIGHT] = SUBMENU_WEIGHT_HIGH;
+  hostEeprom[EEPROM_MOHS] = SUBMENU_MOH_4;
+  hostEeprom[EEPROM_UNITS] = SUBMENU_UNITS_MPA;
+  hostEeprom[EEPROM_AGG_SIZE] = SUBMENU_AGG_SIZE_MED;
+  hostEeprom[EEPROM_ZERO] = 30;
+  hostEeprom[EEPROM_FULL_SCALE] = 220;
+
+  // Tests are two to a day from 1 January 2010, each at its number of minutes
+  // past 9 AM in 24 hour form, with the settings above and shots of 100
+  tests = atoi(argv[1]);
+  hostEeprom[EEPROM_TESTS] = tests;
+  for (i = 0 ; i < tests ; i++)
+  {
+    byte            *record = hostEeprom + i * TEST_SET_SIZE;
+
+    record[0] = ((i / 10) << 4) | (i % 10);
+    record[1] = 0x09;
+    record[2] = (((1 + i / 2) / 10) << 4) | ((1 + i / 2) % 10);
+    record[3] = 0x01;
+    record[4] = 0x10;
+    memcpy(record + 5, hostEeprom + EEPROM_POWER, 8);
+    memset(record + 13, 100, TEST_SHOTS);
+  }
+  hostRtc[2] = 0x09;
+  hostRtc[4] = hostRtc[5] = 0x01;
+  hostRtc[6] = 0x10;
+  hostAdc = 100;
+
+  checkKeys = argv + 2;
+  checkKeysLeft = argc - 2;
+  hostYield = checkScan;
+  firmware_main();
+  return (1);
+}
+"""
+
+SETTINGS = "settings=1 4 16 7 11 13 | calibration=30 220"
+MAIN = ["Measure", "Run Test", "Show Tests", "Download Tests", "Enter Setup"]
+SETUP = ["Show Settings", "Set Settings", "Set Clock", "Calibrate", "Diagnostics", "Summary"]
+
+
+def browse(item, tests=None, settings=None):
+  state = "Main | browse | %s" % item
+  if tests is not None:
+    state += " | tests=%d" % tests
+  return state + (" | " + settings if settings else "")
+
+
+# The main menu after escape, with the settings and calibration unchanged
+def escaped(tests=1):
+  return browse("Measure", tests, SETTINGS)
+
+
+# Enters an Enter Setup screen, which starts on the key after Enter
+def setup(item, moves, state):
+  return ([("DOWN", browse("Enter Setup")), ("ENTER", "Enter Setup | active | Show Settings")] +
+          moves + [("ENTER", "%s | enter | " % item), ("ENTER", "%s | active | %s" % (item, state))])
+
+
+# Each case: its name, the stored tests, and the keys with the state expected
+# after each, or None for ADC=n.  Only the fields given are compared.
+CASES = [
+  ("main menu down", 1, [("DOWN", browse(item)) for item in reversed(MAIN)]),
+  ("main menu up", 1, [("UP", browse(item)) for item in MAIN[1:] + MAIN[:1]]),
+  ("Measure", 1,
+   [("ENTER", "Measure | active | "), ("DOWN", "Measure | active | "), ("ESC", escaped())]),
+  ("Run Test", 1,
+   [("UP", browse("Run Test")), ("ENTER", "Run Test | active | shoot shot 1"),
+    ("ENTER", "Run Test | active | shoot shot 2"), ("ENTER", "Run Test | active | shoot shot 3"),
+    ("ENTER", "Run Test | active | ok"), ("ENTER", browse("Measure", 2, SETTINGS))]),
+  ("Run Test repeated shot", 1,
+   [("UP", browse("Run Test")), ("ENTER", "Run Test | active | shoot shot 1"),
+    ("ENTER", "Run Test | active | shoot shot 2"), ("ENTER", "Run Test | active | shoot shot 3"),
+    ("ADC=200", None), ("ENTER", "Run Test | active | reshoot shot 3"), ("ADC=100", None),
+    ("ENTER", "Run Test | active | ok"), ("ENTER", browse("Measure", 2))]),
+  ("Run Test repeated test", 1,
+   [("UP", browse("Run Test")), ("ENTER", "Run Test | active | shoot shot 1"),
+    ("ENTER", "Run Test | active | shoot shot 2"), ("ENTER", "Run Test | active | shoot shot 3"),
+    ("ADC=200", None), ("ENTER", "Run Test | active | reshoot shot 3"),
+    ("ENTER", "Run Test | active | shoot shot 1"), ("ESC", escaped())]),
+  ("Run Test escape", 1,
+   [("UP", browse("Run Test")), ("ENTER", "Run Test | active | shoot shot 1"),
+    ("ENTER", "Run Test | active | shoot shot 2"), ("ESC", escaped())]),
+  ("Show Tests", 2,
+   [("UP", browse("Run Test")), ("UP", browse("Show Tests")),
+    ("ENTER", "Show Tests | active | date test 1"), ("ENTER", "Show Tests | active | test 1 step 0"),
+    ("UP", "Show Tests | active | test 2 step 0"),
+    ("ENTER", "Show Tests | active | test 2 step 1"), ("ENTER", "Show Tests | active | test 2 step 2"),
+    ("ENTER", "Show Tests | active | test 2 step 3"), ("ENTER", "Show Tests | active | test 2 step 4"),
+    ("ENTER", browse("Measure", 2, SETTINGS))]),
+  ("Show Tests escape", 2,
+   [("UP", browse("Run Test")), ("UP", browse("Show Tests")),
+    ("ENTER", "Show Tests | active | date test 1"), ("ESC", escaped(2))]),
+  ("Show Tests by date", 5,
+   [("UP", browse("Run Test")), ("UP", browse("Show Tests")),
+    ("ENTER", "Show Tests | active | date test 1"), ("UP", "Show Tests | active | date test 3"),
+    ("UP", "Show Tests | active | date test 5"), ("UP", "Show Tests | active | date test 1"),
+    ("DOWN", "Show Tests | active | date test 5"), ("DOWN", "Show Tests | active | date test 3"),
+    ("ENTER", "Show Tests | active | test 3 step 0"), ("ENTER", "Show Tests | active | test 3 step 1"),
+    ("ESC", escaped(5))]),
+  ("Show Tests without tests", 0,
+   [("UP", browse("Run Test")), ("UP", browse("Show Tests")), ("ENTER", browse("Measure", 0))]),
+  ("Download Tests", 2,
+   [("DOWN", browse("Enter Setup")), ("DOWN", browse("Download Tests")),
+    ("ENTER", "Download Tests | active | connect"), ("ENTER", "Download Tests | active | clear"),
+    ("ENTER", browse("Measure", 0))]),
+  ("Download Tests kept", 2,
+   [("DOWN", browse("Enter Setup")), ("DOWN", browse("Download Tests")),
+    ("ENTER", "Download Tests | active | connect"), ("ENTER", "Download Tests | active | clear"),
+    ("ESC", escaped(2))]),
+  ("Download Tests escape", 2,
+   [("DOWN", browse("Enter Setup")), ("DOWN", browse("Download Tests")),
+    ("ENTER", "Download Tests | active | connect"), ("ESC", escaped(2))]),
+  ("Download Tests without tests", 0,
+   [("DOWN", browse("Enter Setup")), ("DOWN", browse("Download Tests")),
+    ("ENTER", browse("Measure", 0))]),
+  ("Enter Setup down", 1,
+   [("DOWN", browse("Enter Setup")), ("ENTER", "Enter Setup | active | Show Settings")] +
+   [("DOWN", "Enter Setup | active | %s" % item) for item in reversed(SETUP)] +
+   [("ESC", escaped())]),
+  ("Enter Setup up", 1,
+   [("DOWN", browse("Enter Setup")), ("ENTER", "Enter Setup | active | Show Settings")] +
+   [("UP", "Enter Setup | active | %s" % item) for item in SETUP[1:] + SETUP[:1]]),
+  ("Show Settings", 1, setup("Show Settings", [], "") + [("ENTER", escaped())]),
+  ("Show Settings escape", 1, setup("Show Settings", [], "") + [("ESC", escaped())]),
+  ("Set Settings standard density", 1,
+   setup("Set Settings", [("UP", "Enter Setup | active | Set Settings")], "Set Power") +
+   [("UP", "Set Settings | active | Set Power"), ("ENTER", "Set Settings | active | Set Density"),
+    ("ENTER", "Set Settings | active | Set Mohs"), ("UP", "Set Settings | active | Set Mohs"),
+    ("ENTER", "Set Settings | active | Set Units"), ("UP", "Set Settings | active | Set Units"),
+    ("ENTER", "Set Settings | active | Set Aggr Size"),
+    ("UP", "Set Settings | active | Set Aggr Size"),
+    ("ENTER", browse("Measure", 1, "settings=2 4 16 8 12 14"))]),
+  ("Set Settings light density", 1,
+   setup("Set Settings", [("UP", "Enter Setup | active | Set Settings")], "Set Power") +
+   [("ENTER", "Set Settings | active | Set Density"), ("UP", "Set Settings | active | Set Density"),
+    ("ENTER", "Set Settings | active | Set Weight"), ("UP", "Set Settings | active | Set Weight"),
+    ("ENTER", "Set Settings | active | Set Units"),
+    ("ENTER", "Set Settings | active | Set Aggr Size"),
+    ("ENTER", browse("Measure", 1, "settings=1 5 17 6 11 13"))]),
+  ("Set Settings high performance", 1,
+   setup("Set Settings", [("UP", "Enter Setup | active | Set Settings")], "Set Power") +
+   [("DOWN", "Set Settings | active | Set Power"), ("ENTER", "Set Settings | active | Set Units"),
+    ("ENTER", "Set Settings | active | Set Aggr Size"),
+    ("DOWN", "Set Settings | active | Set Aggr Size"),
+    ("ENTER", browse("Measure", 1, "settings=3 4 16 7 11 15"))]),
+  ("Set Settings escape", 1,
+   setup("Set Settings", [("UP", "Enter Setup | active | Set Settings")], "Set Power") +
+   [("UP", "Set Settings | active | Set Power"), ("ENTER", "Set Settings | active | Set Density"),
+    ("UP", "Set Settings | active | Set Density"), ("ESC", escaped())]),
+  ("Set Clock", 1,
+   setup("Set Clock", [("DOWN", "Enter Setup | active | Summary"),
+                       ("DOWN", "Enter Setup | active | Diagnostics"),
+                       ("DOWN", "Enter Setup | active | Calibrate"),
+                       ("DOWN", "Enter Setup | active | Set Clock")], "position 1") +
+   [("UP", "Set Clock | active | position 1"), ("ENTER", "Set Clock | active | position 4"),
+    ("ENTER", "Set Clock | active | position 7"), ("ENTER", "Set Clock | active | position 10"),
+    ("ENTER", "Set Clock | active | position 13"), ("ENTER", "Set Clock | active | position 14"),
+    ("ENTER", escaped())]),
+  ("Set Clock escape", 1,
+   setup("Set Clock", [("DOWN", "Enter Setup | active | Summary"),
+                       ("DOWN", "Enter Setup | active | Diagnostics"),
+                       ("DOWN", "Enter Setup | active | Calibrate"),
+                       ("DOWN", "Enter Setup | active | Set Clock")], "position 1") +
+   [("ENTER", "Set Clock | active | position 4"), ("ESC", escaped())]),
+  ("Calibrate", 1,
+   setup("Calibrate", [("DOWN", "Enter Setup | active | Summary"),
+                       ("DOWN", "Enter Setup | active | Diagnostics"),
+                       ("DOWN", "Enter Setup | active | Calibrate")], "start") +
+   [("ENTER", "Calibrate | active | zero"), ("ADC=40", None),
+    ("ENTER", "Calibrate | active | full scale"), ("ADC=230", None),
+    ("ENTER", browse("Measure", 1, "calibration=40 230"))]),
+  ("Calibrate escape", 1,
+   setup("Calibrate", [("DOWN", "Enter Setup | active | Summary"),
+                       ("DOWN", "Enter Setup | active | Diagnostics"),
+                       ("DOWN", "Enter Setup | active | Calibrate")], "start") +
+   [("ENTER", "Calibrate | active | zero"), ("ESC", escaped())]),
+  ("Diagnostics", 1,
+   setup("Diagnostics", [("DOWN", "Enter Setup | active | Summary"),
+                         ("DOWN", "Enter Setup | active | Diagnostics")], "counter 0") +
+   [("UP", "Diagnostics | active | counter 1"), ("DOWN", "Diagnostics | active | counter 0"),
+    ("DOWN", "Diagnostics | active | counter 5"), ("ENTER", "Diagnostics | active | counter 5"),
+    ("ESC", escaped())]),
+  ("Summary", 2,
+   setup("Summary", [("DOWN", "Enter Setup | active | Summary")], "power 1 Ave") +
+   [("ENTER", "Summary | active | power 1 Min"), ("ENTER", "Summary | active | power 1 Max"),
+    ("UP", "Summary | active | power 2 Max"), ("ENTER", "Summary | active | power 2 SD"),
+    ("ENTER", "Summary | active | power 2 Ave"), ("DOWN", "Summary | active | power 1 Ave"),
+    ("DOWN", "Summary | active | power 3 Ave"), ("ESC", escaped(2))]),
+]
+
+
+#******************************************************************************
+#
+#  Function: compare()
+#
+#  Description:
+#  ============
+#  Returns None when the state written by the driver has the expected
+#  fields, or a description of the first one that differs.  The first four
+#  fields are compared by position and the rest by name.
+#
+#******************************************************************************
+def compare(state, expected):
+  fields = state.split(" | ")
+  named = dict(field.split("=", 1) for field in fields[4:] if "=" in field)
+  for index, field in enumerate(expected.split(" | ")):
+    if "=" in field:
+      name, value = field.split("=", 1)
+      if named.get(name) != value:
+        return "%s is %s, not %s" % (name, named.get(name), value)
+    elif index + 1 >= len(fields) or fields[index + 1] != field:
+      return "field %d is \"%s\", not \"%s\"" % (index + 1, fields[index + 1] if index + 1 < len(fields)
+                                                  else "", field)
+  return None
+
+
+def main():
+  program = hostbuild.build(DRIVER)
+  failures = 0
+  transitions = 0
+  for name, tests, steps in CASES:
+    keys = [key for key, expected in steps]
+    result = subprocess.run([program, str(tests)] + keys, stdout=subprocess.PIPE)
+    states = result.stdout.decode("latin-1").splitlines()
+    start = compare(states[0], browse("Measure", tests, SETTINGS)) if states else "no output"
+    if start:
+      print("%s: at start, %s" % (name, start))
+      failures += 1
+      continue
+    states = states[1:]
+    pressed = [(key, expected) for key, expected in steps if expected]
+    if result.returncode or len(states) != len(pressed):
+      print("%s: the driver stopped after %d of %d keys" % (name, len(states), len(pressed)))
+      failures += 1
+      continue
+    for step, ((key, expected), state) in enumerate(zip(pressed, states)):
+      difference = compare(state, expected)
+      transitions += 1
+      if difference:
+        print("%s: after key %d (%s), %s" % (name, step + 1, key, difference))
+        print("  %s" % state)
+        failures += 1
+        break
+  print("%d cases, %d transitions, %d failures" % (len(CASES), transitions, failures))
+  return 1 if failures else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
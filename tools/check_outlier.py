@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: check_outlier.py
+#
+#  Description:
+#  ============
+#  Host check of the Run Test shot check.  The old firmware compared the
+#  three shots pairwise and decoded the result from sums of error codes; the
+#  current firmware sorts them in Display_findOutlier().  This runs
+#  Display_checkTestData() of both builds for every 3-shot input (256^3) at
+#  each agg. size limit and compares what they ask for: no repeat, the
+#  entire test, or one shot.
+#
+#  The builds agree everywhere except where the old code found an error but
+#  no entry in its table, which it left with dataTestNumber past the end of
+#  adcData.  Those inputs are counted, and the new answer must be one shot.
+#
+#  Usage: tools/check_outlier.py old-revision [limit ...]
+#    old-revision is any git revision with the pairwise check, such as the
+#    parent of the commit that added Display_findOutlier().
+#
+#******************************************************************************
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hostbuild
+
+LIMITS = [0, 1, 2, 3, 4, 5, 6, 8, 10, 20, 45]
+INPUTS = 256 ** 3
+
+SHOT_ALL = 0xfe
+SHOT_NONE = 0xff
+SHOT_UNDECIDED = 0xfd
+
+# The old build takes the limit from the calibration: 1170 / adcScale for the
+# large aggregate, so it fails for a limit no scale gives
+OLD_DRIVER = r"""
+int main(int argc, char **argv)
+{
+  int               a, b, c, i;
+  long              scale;
+  static uint8_t    out[256 * 256 * 256];
+
+  for (i = 1 ; i < argc ; i++)
+  {
+    for (scale = 1 ; scale < 2000 && AGG_SIZE_LIMIT_3_MPA / scale != atoi(argv[i]) ; scale++);
+    if (AGG_SIZE_LIMIT_3_MPA / scale != atoi(argv[i]))
+    {
+      return (1);
+    }
+    adcScale = scale;
+    submenuAggSize = SUBMENU_AGG_SIZE_LARGE;
+    for (a = 0 ; a < 256 ; a++)
+    for (b = 0 ; b < 256 ; b++)
+    for (c = 0 ; c < 256 ; c++)
+    {
+      adcData[0] = a; adcData[1] = b; adcData[2] = c;
+      dataTestNumber = SHOT_UNDECIDED;
+      testDone = true;
+      testError = false;
+      testOk = false;
+      Display_checkTestData();
+      if (testOk)
+        out[(a << 16) | (b << 8) | c] = TEST_SHOT_NONE_VALUE;
+      else if (!testDone)
+        out[(a << 16) | (b << 8) | c] = TEST_SHOT_ALL_VALUE;
+      else
+        out[(a << 16) | (b << 8) | c] = dataTestNumber;
+    }
+    fwrite(out, 1, sizeof(out), stdout);
+  }
+  return (0);
+}
+"""
+
+NEW_DRIVER = r"""
+int main(int argc, char **argv)
+{
+  int               a, b, c, i;
+  static uint8_t    out[256 * 256 * 256];
+
+  for (i = 1 ; i < argc ; i++)
+  {
+    settings.aggSizeLimit = atoi(argv[i]);
+    for (a = 0 ; a < 256 ; a++)
+    for (b = 0 ; b < 256 ; b++)
+    for (c = 0 ; c < 256 ; c++)
+    {
+      adcData[0] = a; adcData[1] = b; adcData[2] = c;
+      dataTestNumber = SHOT_UNDECIDED;
+      testState = TEST_STATE_SHOOT;
+      Display_checkTestData();
+      if (testState == TEST_STATE_OK)
+        out[(a << 16) | (b << 8) | c] = TEST_SHOT_NONE_VALUE;
+      else if (testState == TEST_STATE_SHOOT)
+        out[(a << 16) | (b << 8) | c] = TEST_SHOT_ALL_VALUE;
+      else
+        out[(a << 16) | (b << 8) | c] = dataTestNumber;
+    }
+    fwrite(out, 1, sizeof(out), stdout);
+  }
+  return (0);
+}
+"""
+
+VALUES = ["SHOT_UNDECIDED=%d" % SHOT_UNDECIDED, "TEST_SHOT_ALL_VALUE=%d" % SHOT_ALL,
+          "TEST_SHOT_NONE_VALUE=%d" % SHOT_NONE]
+
+
+def describe(decision):
+  if decision == SHOT_NONE:
+    return "no repeat"
+  if decision == SHOT_ALL:
+    return "entire test"
+  if decision == SHOT_UNDECIDED:
+    return "no shot chosen"
+  return "shot %d" % (decision + 1)
+
+
+def main():
+  if len(sys.argv) < 2:
+    print("Usage: %s old-revision [limit ...]" % sys.argv[0])
+    return 2
+  old_revision = sys.argv[1]
+  arguments = sys.argv[2:]
+  limits = [int(argument) for argument in arguments] or LIMITS
+  defines = [value.replace("=", " ") for value in VALUES]
+  old_program = hostbuild.build(OLD_DRIVER, old_revision, defines)
+  new_program = hostbuild.build(NEW_DRIVER, None, defines)
+
+  # One process per build and limit, run side by side
+  runs = {}
+  for limit in limits:
+    for program in (old_program, new_program):
+      output = tempfile.TemporaryFile()
+      runs[(program, limit)] = (subprocess.Popen([program, str(limit)], stdout=output), output)
+  outputs = {}
+  for (program, limit), (process, output) in runs.items():
+    if process.wait():
+      print("%s build failed for limit %d" % ("old" if program == old_program else "new", limit))
+      return 1
+    output.seek(0)
+    outputs[(program, limit)] = output.read()
+
+  failures = 0
+  for limit in limits:
+    old = outputs[(old_program, limit)]
+    new = outputs[(new_program, limit)]
+    undecided = 0
+    differences = 0
+    for start in range(0, INPUTS, 256):
+      if old[start:start + 256] == new[start:start + 256]:
+        continue
+      for shots in range(start, start + 256):
+        if old[shots] == new[shots]:
+          continue
+        if old[shots] == SHOT_UNDECIDED and new[shots] < 3:
+          undecided += 1
+          continue
+        differences += 1
+        if failures + differences <= 10:
+          print("limit %d shots %d %d %d: old %s, new %s" % (
+            limit, shots >> 16, (shots >> 8) & 255, shots & 255,
+            describe(old[shots]), describe(new[shots])))
+    print("limit %3d: %d inputs agree, %d the old code left undecided, %d differ" % (
+      limit, INPUTS - undecided - differences, undecided, differences))
+    failures += differences
+  print("%d differences" % failures)
+  return 1 if failures else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: check_serial.py
+#
+#  Description:
+#  ============
+#  Host check of the serial protocol, end to end.  It runs one probe with
+#  tools/emulator.py, in real time, and talks to its pty through
+#  tools/probe.py while a key script goes to "Connect PC", starts two
+#  downloads and leaves the tests in place between them:
+#
+#    - S and C answer the settings and calibration the image was made with
+#    - R returns the stored tests and T the ones at or after a test's time
+#    - ACKs sent after a reply to R are not counted, and the S sent with
+#      them is answered
+#    - the first download sends every test, of which two are acknowledged,
+#      and the second sends only the rest
+#    - the image saved when the probe stops holds the two acknowledged tests
+#
+#  Usage: tools/check_serial.py
+#
+#******************************************************************************
+import os
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import probe
+
+TESTS = 5
+CALIBRATION = [40, 200]
+SETTINGS = [1, 4, 17, 7, 11, 14]                  # SETTING_TABLE keyBelow, as a new image has
+ACKED = 2
+EEPROM_TESTS = 8151
+EEPROM_UPLOADED = 8152
+
+# Down to Download Tests and Enter for "Connect PC", the first download, Esc
+# to keep the tests, and the same again for the second download
+KEYS = """1000 DOWN
+1500 DOWN
+2000 ENTER
+8000 ENTER
+11000 ESC
+12000 DOWN
+12500 DOWN
+13000 ENTER
+14000 ENTER
+"""
+COMMANDS_START = 3.0                              # Seconds, after "Connect PC"
+
+
+def main():
+  directory = tempfile.mkdtemp(prefix="windsor-serial-")
+  image = os.path.join(directory, "probe.bin")
+  keys = os.path.join(directory, "keys")
+  open(keys, "w").write(KEYS)
+  emulator = subprocess.Popen([sys.executable, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                            "emulator.py"),
+                               "-e", image, "-k", keys, "-t", str(TESTS),
+                               "-c", "%d,%d" % tuple(CALIBRATION)],
+                              stdout=subprocess.PIPE, universal_newlines=True)
+  failures = []
+
+  def check(name, value, expected):
+    if value != expected:
+      failures.append("%s: %s, not %s" % (name, value, expected))
+
+  try:
+    port = probe.open_port(emulator.stdout.readline().strip())
+    started = time.time()
+    time.sleep(COMMANDS_START)
+
+    check("S", probe.settings(port), SETTINGS)
+    check("C", probe.calibration(port), CALIBRATION)
+    tests = probe.records(port, 1, TESTS)
+    check("R 1 %d count" % TESTS, len(tests), TESTS)
+    check("R 2 3", probe.records(port, 2, 3), tests[1:3])
+    check("R 4 99", probe.records(port, 4, 99), tests[3:])
+    check("T at test 3", probe.since(port, tests[2][:5]), tests[2:])
+
+    # ACKs after a command reply are not counted, and don't swallow the S
+    check("R 1 2", probe.records(port, 1, 2), tests[:2])
+    os.write(port, bytes([probe.ACK] * ACKED) + b"S")
+    check("S after ACKs", list(probe.receive(port, len(SETTINGS))), SETTINGS)
+    if time.time() - started > 7.0:
+      failures.append("the commands took past the first download")
+
+    first = probe.download(port, ACKED)
+    check("first download", first, tests)
+    second = probe.download(port)
+    check("second download", second, tests[ACKED:])
+  except probe.ProbeError as error:
+    failures.append(str(error))
+  finally:
+    emulator.send_signal(signal.SIGINT)
+    emulator.wait()
+
+  saved = open(image, "rb").read() if os.path.exists(image) else b""
+  if len(saved) > EEPROM_UPLOADED:
+    check("stored tests", saved[EEPROM_TESTS], TESTS)
+    check("acknowledged tests", saved[EEPROM_UPLOADED], ACKED)
+  else:
+    failures.append("the probe saved no image")
+
+  for failure in failures:
+    print(failure)
+  print("%d failures" % len(failures))
+  return 1 if failures else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
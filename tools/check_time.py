@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: check_time.py
+#
+#  Description:
+#  ============
+#  Host check of the packed test times.  Peripheral_packTime() must grow with
+#  the time, or the binary searches of Show Tests and the T command find the
+#  wrong test.  Set Clock leaves the clock in 12 hour mode, where 12 AM comes
+#  after 11 AM in BCD and PM is a flag, so this packs every minute of days
+#  that run across midnight, noon, the end of a month and the end of a year:
+#
+#    - in 12 hour form the packed times must increase minute by minute
+#    - the 24 hour form of each minute must pack to the same time
+#    - with 99 of the minutes stored as tests, Peripheral_findRecord() must
+#      find each test by its own time, and the one after it from one minute
+#      later
+#
+#  Usage: tools/check_time.py
+#
+#******************************************************************************
+import datetime
+import os
+import struct
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hostbuild
+
+# The first day of each run of days checked
+DAYS = [datetime.datetime(2025, 12, 30), datetime.datetime(2026, 2, 27),
+        datetime.datetime(2028, 2, 28)]
+RUN_DAYS = 3
+
+# Reads "count" times of RECORD_TIME_SIZE bytes from the standard input and
+# writes the packed time of each.  With an argument, the times are first
+# stored as tests, and for each one the driver writes the test found at its
+# time and at its time + 1.
+DRIVER = r"""
+int main(int argc, char **argv)
+{
+  byte              time[RECORD_TIME_SIZE];
+  uint32_t          stamp;
+  int               test;
+
+  test = 0;
+  while (fread(time, 1, RECORD_TIME_SIZE, stdin) == RECORD_TIME_SIZE)
+  {
+    if (argc > 1)
+    {
+      memcpy(&hostEeprom[test * TEST_SET_SIZE], time, RECORD_TIME_SIZE);
+    }
+    else
+    {
+      stamp = Peripheral_packTime(time);
+      fwrite(&stamp, 4, 1, stdout);
+    }
+    ++test;
+  }
+  if (argc > 1)
+  {
+    testSetCount = test;
+    for (test = 1 ; test <= testSetCount ; test++)
+    {
+      Peripheral_readRecordTimes(test, 1, time);
+      stamp = Peripheral_packTime(time);
+      putchar(Peripheral_findRecord(stamp));
+      putchar(Peripheral_findRecord(stamp + 1));
+    }
+  }
+  return (0);
+}
+"""
+
+
+def bcd(value):
+  return (value // 10) << 4 | value % 10
+
+
+#******************************************************************************
+#
+#  Function: encode()
+#
+#  Description:
+#  ============
+#  Returns the time as the RECORD_MINUTES to RECORD_YEAR bytes, with the hours
+#  in the clock's 12 or 24 hour form.
+#
+#******************************************************************************
+def encode(when, twelve):
+  if twelve:
+    hour = when.hour % 12 or 12
+    hours = 0x40 | (0x20 if when.hour >= 12 else 0) | bcd(hour)
+  else:
+    hours = bcd(when.hour)
+  return bytes([bcd(when.minute), hours, bcd(when.day), bcd(when.month), bcd(when.year % 100)])
+
+
+def main():
+  minutes = []
+  for first in DAYS:
+    minutes += [first + datetime.timedelta(minutes=minute) for minute in range(RUN_DAYS * 24 * 60)]
+  program = hostbuild.build(DRIVER, name="time")
+
+  failures = 0
+  packed = {}
+  for twelve in (True, False):
+    data = b"".join(encode(when, twelve) for when in minutes)
+    output = subprocess.run([program], input=data, check=True, stdout=subprocess.PIPE).stdout
+    packed[twelve] = struct.unpack("<%dI" % len(minutes), output)
+  for index, when in enumerate(minutes):
+    if packed[True][index] != packed[False][index]:
+      failures += 1
+      if failures <= 10:
+        print("%s: 12 hour form packs to %#x, 24 hour form to %#x" % (
+          when, packed[True][index], packed[False][index]))
+    if index and minutes[index - 1] < when and packed[True][index - 1] >= packed[True][index]:
+      failures += 1
+      if failures <= 10:
+        print("%s packs to %#x, not after %s (%#x)" % (
+          when, packed[True][index], minutes[index - 1], packed[True][index - 1]))
+
+  # 99 tests around each midnight and noon of the first run
+  tests = [DAYS[0] + datetime.timedelta(hours=hour, minutes=minute)
+           for hour in (0, 12, 24, 36, 48, 60) for minute in range(-9, 10) if hour or minute >= 0]
+  tests = tests[:99]
+  data = b"".join(encode(when, True) for when in tests)
+  output = subprocess.run([program, "store"], input=data, check=True, stdout=subprocess.PIPE).stdout
+  for number, when in enumerate(tests, 1):
+    found, after = output[2 * number - 2], output[2 * number - 1]
+    if (found, after) != (number, number + 1):
+      failures += 1
+      if failures <= 10:
+        print("test %d (%s): found test %d at its time and %d after it" % (number, when, found, after))
+
+  print("%d minutes packed, %d tests searched, %d failures" % (len(minutes), len(tests), failures))
+  return 1 if failures else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: decode.py
+#
+#  Description:
+#  ============
+#  Decodes EEPROM images (8 KB dumps of the 24LC64, as the emulator keeps
+#  them) to CSV.  The decoder is the firmware built for the host by
+#  tools/hostbuild.py with the driver in tools/host/decoder.c, so the
+#  distance and strength of each test come from the firmware's own math.
+#  The images are decoded on several threads; the rows keep the order of the
+#  images given.
+#
+#  Usage: tools/decode.py [-i] [-j threads] [-o file.csv] image ...
+#    -i  one row per image (tests, uploaded, first and last test times and
+#        the calibration) in place of one row per test
+#    -j  the number of threads (one per processor)
+#    -o  the CSV file, in place of the standard output
+#
+#******************************************************************************
+import argparse
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hostbuild
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Decode EEPROM images to CSV.")
+  parser.add_argument("-i", action="store_true", dest="index")
+  parser.add_argument("-j", type=int, default=os.cpu_count(), dest="threads")
+  parser.add_argument("-o", dest="output")
+  parser.add_argument("images", nargs="+")
+  arguments = parser.parse_args()
+
+  driver = open(os.path.join(hostbuild.HOST, "decoder.c")).read()
+  program = hostbuild.build(driver, name="decoder")
+  options = ["-j", str(arguments.threads)]
+  if arguments.index:
+    options.append("-i")
+  output = open(arguments.output, "w") if arguments.output else None
+  return subprocess.run([program] + options + arguments.images, stdout=output).returncode
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: emulator.py
+#
+#  Description:
+#  ============
+#  Runs emulated probes for testing PC software.  Each probe is the firmware
+#  built for the host by tools/hostbuild.py with the driver in
+#  tools/host/emulator.c, so it answers a download and the serial commands
+#  exactly as the firmware does.  Each one serves its UART on a
+#  pseudo-terminal and keeps its EEPROM in an image file.
+#
+#  By default each probe goes to Download Tests and waits at "Connect PC",
+#  which is where the PC can download and send commands.  The pty of each
+#  probe is printed, one per line, in the order of the images.  Ctrl-C stops
+#  the probes, and each saves its EEPROM image.
+#
+#  Usage: tools/emulator.py [-n count] [-e image] [-k keys] [-a adc]
+#                           [-c zero,full] [-t tests] [-f] [-v]
+#    -n  the number of probes (1)
+#    -e  the EEPROM image, with %d for the probe number when there are
+#        several ("probe%d.bin")
+#    -k  the key script, in place of the one that goes to "Connect PC"
+#    -a  the ADC script
+#    -c  the calibration of new images
+#    -t  the number of made-up tests in new images (10); Download Tests
+#        needs at least one
+#    -f  run as fast as the host can instead of in real time
+#    -v  show the LCD of each probe on the standard error
+#
+#  See tools/host/emulator.c for the scripts.
+#
+#******************************************************************************
+import argparse
+import os
+import signal
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hostbuild
+
+# From the start-up screen: Down to Enter Setup, Down to Download Tests,
+# Enter for "Connect PC"
+CONNECT_KEYS = "1000 DOWN\n1500 DOWN\n2000 ENTER\n"
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Run emulated probes on ptys.")
+  parser.add_argument("-n", type=int, default=1, dest="count")
+  parser.add_argument("-e", default="probe%d.bin", dest="image")
+  parser.add_argument("-k", dest="keys")
+  parser.add_argument("-a", dest="adc")
+  parser.add_argument("-c", dest="calibration")
+  parser.add_argument("-t", type=int, default=10, dest="tests")
+  parser.add_argument("-f", action="store_true", dest="fast")
+  parser.add_argument("-v", action="store_true", dest="verbose")
+  arguments = parser.parse_args()
+
+  driver = open(os.path.join(hostbuild.HOST, "emulator.c")).read()
+  program = hostbuild.build(driver, name="emulator")
+  keys = arguments.keys
+  if not keys:
+    keys = os.path.join(os.path.dirname(program), "connect.keys")
+    open(keys, "w").write(CONNECT_KEYS)
+
+  options = ["-k", keys, "-t", str(arguments.tests)]
+  if arguments.adc:
+    options += ["-a", arguments.adc]
+  if arguments.calibration:
+    options += ["-c", arguments.calibration]
+  if arguments.fast:
+    options.append("-f")
+  if arguments.verbose:
+    options.append("-v")
+
+  probes = []
+  for number in range(1, arguments.count + 1):
+    image = arguments.image % number if "%" in arguments.image else arguments.image
+    probes.append(subprocess.Popen([program, "-e", image] + options,
+                                   stdout=subprocess.PIPE, universal_newlines=True))
+  for probe in probes:
+    print(probe.stdout.readline().strip())
+  sys.stdout.flush()
+
+  try:
+    for probe in probes:
+      probe.wait()
+  except KeyboardInterrupt:
+    for probe in probes:
+      probe.send_signal(signal.SIGTERM)
+    for probe in probes:
+      probe.wait()
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
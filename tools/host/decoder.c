@@ -0,0 +1,284 @@
+//******************************************************************************
+//  Filename: decoder.c
+//
+//  Description:
+//  ============
+//  Driver for tools/decode.py: decodes EEPROM images (8 KB dumps of the
+//  24LC64) with the firmware's own definitions and math, and writes CSV to
+//  the standard output.  Each image is memory-mapped, and the images are
+//  shared out between threads; the rows still come out in the order of the
+//  images given.
+//
+//  One row per test: the time, the settings as the probe names them, the
+//  calibration, the shots, and the distance and strength of the average
+//  shot from Display_calculateDistance() and Display_calculateStrength(),
+//  scaled for display as Display_showDistance() and
+//  Display_updateDisplayPressure() do.  With -i, one row per image instead:
+//  the number of tests, how many the PC acknowledged, the first and last
+//  test times and the calibration.
+//
+//  Usage: decoder [-i] [-j threads] image ...
+//
+//******************************************************************************
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ROW_SIZE                        256
+
+typedef struct
+{
+  const char        *path;
+  char              *text;                        // The rows, or NULL if the image is bad
+} Image;
+
+static int          imageCount;
+static int          imageNext;
+static pthread_mutex_t imageLock = PTHREAD_MUTEX_INITIALIZER;
+static Image        *images;
+static int          indexOnly;
+
+
+static int fromBcd(uint8_t value)
+{
+  return ((value >> 4) * 10 + (value & 0x0f));
+}
+
+
+// Writes the test's time as "20YY-MM-DD HH:MM", with the 12 hour clock
+// turned to 24 hours
+static void formatTime(char *text, const uint8_t *record)
+{
+  uint8_t           hours;
+  int               hour;
+
+  hours = record[RECORD_HOURS];
+  if (hours & 0x40)
+  {
+    hour = fromBcd(hours & 0x1f) % 12 + ((hours & 0x20) ? 12 : 0);
+  }
+  else
+  {
+    hour = fromBcd(hours & 0x3f);
+  }
+  sprintf(text, "20%02d-%02d-%02d %02d:%02d", fromBcd(record[RECORD_YEAR]),
+          fromBcd(record[RECORD_MONTH]), fromBcd(record[RECORD_DAY]), hour,
+          fromBcd(record[RECORD_MINUTES]));
+}
+
+
+// Writes the label the probe shows for a setting, or its value if it has none
+static void formatSetting(char *text, uint8_t value, uint8_t units)
+{
+  const char        *label;
+  int               length;
+
+  label = "";
+  if ((value <= SUBMENU_WEIGHT_SUPER_LOW) && (units >= SUBMENU_UNITS_MPA) && (units <= SUBMENU_UNITS_PSI))
+  {
+    label = LABEL_TEXT[SETTING_LABEL[units - SUBMENU_UNITS_MPA][value]];
+  }
+  length = strlen(label);
+  while (length && (label[length - 1] == ' '))
+  {
+    --length;
+  }
+  if (length)
+  {
+    sprintf(text, "%.*s", length, label);
+  }
+  else
+  {
+    sprintf(text, "%d", value);
+  }
+}
+
+
+static char *decodeImage(const uint8_t *eeprom)
+{
+  char              first[20];
+  int               i;
+  char              last[20];
+  uint32_t          length;
+  const uint8_t     *record;
+  char              settings[6][20];
+  char              *text;
+  char              *row;
+  uint32_t          strength;
+  int               tests;
+  uint16_t          total;
+
+  tests = eeprom[EEPROM_TESTS];
+  if (tests > TEST_MAX_SETS)
+  {
+    return (NULL);
+  }
+
+  text = malloc((size_t) (tests + 1) * ROW_SIZE);
+  row = text;
+  *row = 0;
+  if (indexOnly)
+  {
+    strcpy(first, "");
+    strcpy(last, "");
+    if (tests)
+    {
+      formatTime(first, eeprom);
+      formatTime(last, eeprom + (tests - 1) * TEST_SET_SIZE);
+    }
+    sprintf(row, "%d,%d,%s,%s,%d,%d", tests, eeprom[EEPROM_UPLOADED], first, last,
+            eeprom[EEPROM_ZERO], eeprom[EEPROM_FULL_SCALE]);
+    return (text);
+  }
+
+  for (record = eeprom ; record < eeprom + tests * TEST_SET_SIZE ; record += TEST_SET_SIZE)
+  {
+    formatTime(first, record);
+    for (i = 0 ; i < 6 ; i++)
+    {
+      formatSetting(settings[i], record[RECORD_POWER + i], record[RECORD_UNITS]);
+    }
+    total = 0;
+    for (i = 0 ; i < TEST_SHOTS ; i++)
+    {
+      total += record[RECORD_SHOTS + i];
+    }
+    length = Display_calculateDistance(total / TEST_SHOTS, record[RECORD_ZERO],
+               Display_calculateScale(record[RECORD_ZERO], record[RECORD_FULL_SCALE]));
+    strength = Display_calculateStrength((byte *) record);
+    row += sprintf(row, "%d,%s,%s,%s,%s,%s,%s,%s,%d,%d,%d,%d,%d,%.1f,%.2f,%.1f,%u\n",
+                   (int) ((record - eeprom) / TEST_SET_SIZE) + 1, first,
+                   settings[0], settings[1], settings[2], settings[3], settings[4], settings[5],
+                   record[RECORD_ZERO], record[RECORD_FULL_SCALE],
+                   record[RECORD_SHOTS], record[RECORD_SHOTS + 1], record[RECORD_SHOTS + 2],
+                   (double) ((length * DISTANCE_MULT_METRIC) >> DISTANCE_SHIFT) / 10,
+                   (double) ((length * DISTANCE_MULT_IMPERIAL) >> DISTANCE_SHIFT) / 100,
+                   (double) ((strength * PRESSURE_MULT_METRIC) >> PRESSURE_SHIFT) / 10,
+                   (strength * PRESSURE_MULT_IMPERIAL) >> PRESSURE_SHIFT);
+  }
+  if (row > text)
+  {
+    row[-1] = 0;                                  // The caller ends each image's rows
+  }
+  return (text);
+}
+
+
+static void *decodeImages(void *unused)
+{
+  int               descriptor;
+  Image             *image;
+  void              *map;
+  struct stat       status;
+
+  (void) unused;
+  while (1)
+  {
+    pthread_mutex_lock(&imageLock);
+    image = (imageNext < imageCount) ? &images[imageNext++] : NULL;
+    pthread_mutex_unlock(&imageLock);
+    if (!image)
+    {
+      return (NULL);
+    }
+
+    descriptor = open(image->path, O_RDONLY);
+    if ((descriptor < 0) || fstat(descriptor, &status) || (status.st_size < HOST_EEPROM_SIZE))
+    {
+      if (descriptor >= 0)
+      {
+        close(descriptor);
+      }
+      continue;
+    }
+    map = mmap(NULL, HOST_EEPROM_SIZE, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (map == MAP_FAILED)
+    {
+      continue;
+    }
+    image->text = decodeImage(map);
+    munmap(map, HOST_EEPROM_SIZE);
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  int               bad;
+  int               i;
+  int               option;
+  int               threadCount;
+  pthread_t         *threads;
+
+  threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+  while ((option = getopt(argc, argv, "ij:")) != -1)
+  {
+    switch (option)
+    {
+    case 'i':
+      indexOnly = 1;
+      break;
+    case 'j':
+      threadCount = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-i] [-j threads] image ...\n", argv[0]);
+      return (1);
+    }
+  }
+  if (threadCount < 1)
+  {
+    threadCount = 1;
+  }
+
+  imageCount = argc - optind;
+  images = calloc(imageCount + 1, sizeof(Image));
+  for (i = 0 ; i < imageCount ; i++)
+  {
+    images[i].path = argv[optind + i];
+  }
+  threads = calloc(threadCount, sizeof(pthread_t));
+  for (i = 0 ; i < threadCount ; i++)
+  {
+    pthread_create(&threads[i], NULL, decodeImages, NULL);
+  }
+  for (i = 0 ; i < threadCount ; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  if (indexOnly)
+  {
+    printf("file,tests,uploaded,first,last,zero,full_scale\n");
+  }
+  else
+  {
+    printf("file,test,time,power,density,weight,mohs,units,agg_size,zero,full_scale,"
+           "shot1,shot2,shot3,distance_mm,distance_in,strength_mpa,strength_psi\n");
+  }
+  bad = 0;
+  for (i = 0 ; i < imageCount ; i++)
+  {
+    if (!images[i].text)
+    {
+      fprintf(stderr, "%s: not an EEPROM image\n", images[i].path);
+      ++bad;
+      continue;
+    }
+    if (images[i].text[0])
+    {
+      char          *line;
+
+      // Each row starts with the image's name
+      for (line = strtok(images[i].text, "\n") ; line ; line = strtok(NULL, "\n"))
+      {
+        printf("%s,%s\n", images[i].path, line);
+      }
+    }
+    free(images[i].text);
+  }
+  return (bad ? 2 : 0);
+}
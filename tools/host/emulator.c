@@ -0,0 +1,421 @@
+//******************************************************************************
+//  Filename: emulator.c
+//
+//  Description:
+//  ============
+//  Driver for tools/emulator.py: runs the firmware's main() as one emulated
+//  probe.  The UART is a pseudo-terminal, whose name is printed on the first
+//  line of the standard output, so PC software opens it like the probe's
+//  serial port.  The EEPROM is loaded from an image file and written back
+//  when the probe is stopped with SIGINT or SIGTERM.  A new image starts
+//  erased except for the default settings, the calibration given with -c and
+//  the number of made-up tests given with -t, ten minutes apart up to now.
+//  The clock starts at the host's local time in 12 hour mode, as Set Clock
+//  leaves it.  Download Tests needs at least one test to reach "Connect PC".
+//
+//  Keypresses and ADC readings come from scripts, one "milliseconds value"
+//  pair per line, in time order:
+//
+//    keys:  the key to press at that time: DOWN, UP, ENTER or ESC.  Each
+//           press is held for KEY_HOLD_MS.
+//    adc:   the ADC reading from that time on, 0 to 255.
+//
+//  Emulated time follows the wall clock, so a probe waits for the PC as a
+//  real one does, unless -f is given.
+//
+//  Usage: emulator -e image [-k keys] [-a adc] [-c zero,full] [-t tests] [-f] [-v]
+//
+//******************************************************************************
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KEY_HOLD_MS                     150
+#define SCRIPT_MAX                      4096
+
+typedef struct
+{
+  uint32_t          ms;
+  uint8_t           value;
+} ScriptStep;
+
+static ScriptStep   adcScript[SCRIPT_MAX];
+static int          adcSteps;
+static int          adcNext;
+static byte         calibration[2] = {30, 220};
+static const char   *eepromPath;
+static int          fast;
+static ScriptStep   keyScript[SCRIPT_MAX];
+static int          keySteps;
+static int          keyNext;
+static uint32_t     keyReleaseMs;
+static char         lcdShown[2][17];
+static uint32_t     lastMicros;
+static int          ptyMaster = -1;
+static volatile sig_atomic_t stopRequested;
+static int          tests;
+static int          verbose;
+static uint64_t     wallStart;
+
+
+static uint64_t wallMicros(void)
+{
+  struct timeval    now;
+
+  gettimeofday(&now, NULL);
+  return ((uint64_t) now.tv_sec * 1000000 + now.tv_usec);
+}
+
+
+static void stop(int signal)
+{
+  (void) signal;
+  stopRequested = 1;
+}
+
+
+//******************************************************************************
+//  Scripts
+//******************************************************************************
+static int keyValue(const char *name)
+{
+  // The raw codes of Keyboard_getKeyRaw(), which are the *_KEY values
+  if (!strcmp(name, "DOWN"))
+  {
+    return (DOWN_KEY);
+  }
+  if (!strcmp(name, "UP"))
+  {
+    return (UP_KEY);
+  }
+  if (!strcmp(name, "ENTER"))
+  {
+    return (ENTER_KEY);
+  }
+  if (!strcmp(name, "ESC"))
+  {
+    return (ESC_KEY);
+  }
+  return (-1);
+}
+
+
+static int loadScript(const char *path, ScriptStep *steps, int keys)
+{
+  char              line[128];
+  char              name[32];
+  int               count;
+  FILE              *file;
+  unsigned long     ms;
+  int               value;
+
+  file = fopen(path, "r");
+  if (!file)
+  {
+    perror(path);
+    exit(1);
+  }
+  count = 0;
+  while (fgets(line, sizeof(line), file) && (count < SCRIPT_MAX))
+  {
+    if ((line[0] == '#') || (sscanf(line, "%lu %31s", &ms, name) != 2))
+    {
+      continue;
+    }
+    value = keys ? keyValue(name) : atoi(name);
+    if ((value < 0) || (value > 255))
+    {
+      fprintf(stderr, "%s: bad value \"%s\"\n", path, name);
+      exit(1);
+    }
+    steps[count].ms = ms;
+    steps[count].value = value;
+    ++count;
+  }
+  fclose(file);
+  return (count);
+}
+
+
+static uint8_t scriptAdc(void)
+{
+  uint32_t          ms;
+
+  ms = hostMicros / 1000;
+  while ((adcNext < adcSteps) && (adcScript[adcNext].ms <= ms))
+  {
+    hostAdc = adcScript[adcNext++].value;
+  }
+  return (hostAdc);
+}
+
+
+//******************************************************************************
+//  EEPROM image
+//******************************************************************************
+static uint8_t toBcd(int value)
+{
+  return ((uint8_t) (((value / 10) << 4) | (value % 10)));
+}
+
+
+// Sets the seven DS1307 registers to the local time, in 12 hour mode
+static void rtcTime(time_t when, uint8_t *registers)
+{
+  int               hour;
+  struct tm         *local;
+
+  local = localtime(&when);
+  hour = local->tm_hour % 12 ? local->tm_hour % 12 : 12;
+  registers[0] = toBcd(local->tm_sec);
+  registers[1] = toBcd(local->tm_min);
+  registers[2] = 0x40 | (local->tm_hour >= 12 ? 0x20 : 0) | toBcd(hour);
+  registers[3] = local->tm_wday + 1;
+  registers[4] = toBcd(local->tm_mday);
+  registers[5] = toBcd(local->tm_mon + 1);
+  registers[6] = toBcd(local->tm_year % 100);
+}
+
+
+static void loadEeprom(void)
+{
+  FILE              *file;
+  int               i;
+  uint8_t           *record;
+  uint8_t           registers[7];
+  int               shot;
+  int               span;
+  int               test;
+
+  memset(hostEeprom, 0xff, sizeof(hostEeprom));
+  file = fopen(eepromPath, "rb");
+  if (file)
+  {
+    if (fread(hostEeprom, 1, sizeof(hostEeprom), file) != sizeof(hostEeprom))
+    {
+      fprintf(stderr, "%s: short image, the rest is erased\n", eepromPath);
+    }
+    fclose(file);
+    return;
+  }
+
+  // The settings are stored in SETTING_TABLE order
+  for (i = 0 ; i < SETTING_COUNT ; i++)
+  {
+    hostEeprom[EEPROM_POWER + i] = SETTING_TABLE[i].keyBelow;
+  }
+  hostEeprom[EEPROM_ZERO] = calibration[0];
+  hostEeprom[EEPROM_FULL_SCALE] = calibration[1];
+
+  // Tests as Peripheral_saveData() stores them, with the shots around the
+  // middle of the calibration
+  span = calibration[1] - calibration[0];
+  for (test = 0 ; test < tests ; test++)
+  {
+    record = &hostEeprom[test * TEST_SET_SIZE];
+    rtcTime(time(NULL) - (time_t) (tests - test) * 600, registers);
+    record[RECORD_MINUTES] = registers[1];
+    record[RECORD_HOURS] = registers[2];
+    record[RECORD_DAY] = registers[4];
+    record[RECORD_MONTH] = registers[5];
+    record[RECORD_YEAR] = registers[6];
+    memcpy(&record[RECORD_POWER], &hostEeprom[EEPROM_POWER], RECORD_SHOTS - RECORD_POWER);
+    for (shot = 0 ; shot < TEST_SHOTS ; shot++)
+    {
+      record[RECORD_SHOTS + shot] = calibration[0] + span / 2 + (rand() % 5) - 2;
+    }
+  }
+  hostEeprom[EEPROM_TESTS] = tests;
+  hostEeprom[EEPROM_UPLOADED] = 0;
+}
+
+
+static void saveEeprom(void)
+{
+  FILE              *file;
+
+  file = fopen(eepromPath, "wb");
+  if (!file || (fwrite(hostEeprom, 1, sizeof(hostEeprom), file) != sizeof(hostEeprom)))
+  {
+    perror(eepromPath);
+    exit(1);
+  }
+  fclose(file);
+}
+
+
+//******************************************************************************
+//  Pseudo-terminal
+//******************************************************************************
+static void openPty(void)
+{
+  struct termios    settings;
+  int               slave;
+
+  ptyMaster = posix_openpt(O_RDWR | O_NOCTTY);
+  if ((ptyMaster < 0) || grantpt(ptyMaster) || unlockpt(ptyMaster))
+  {
+    perror("posix_openpt");
+    exit(1);
+  }
+
+  // Raw bytes both ways.  Holding the slave open keeps the master usable
+  // while no PC has it open.
+  slave = open(ptsname(ptyMaster), O_RDWR | O_NOCTTY);
+  if (slave < 0)
+  {
+    perror(ptsname(ptyMaster));
+    exit(1);
+  }
+  tcgetattr(slave, &settings);
+  cfmakeraw(&settings);
+  cfsetspeed(&settings, B9600);
+  tcsetattr(slave, TCSANOW, &settings);
+  fcntl(ptyMaster, F_SETFL, O_NONBLOCK);
+  printf("%s\n", ptsname(ptyMaster));
+  fflush(stdout);
+}
+
+
+static void sendByte(uint8_t data)
+{
+  while ((write(ptyMaster, &data, 1) < 0) && (errno == EAGAIN))
+  {
+    usleep(1000);
+  }
+}
+
+
+//******************************************************************************
+//  Called on each key scan and UART poll
+//******************************************************************************
+static void yield(void)
+{
+  uint8_t           data[256];
+  uint64_t          elapsed;
+  ssize_t           count;
+  int               row;
+  uint32_t          ms;
+
+  if (stopRequested)
+  {
+    saveEeprom();
+    exit(0);
+  }
+
+  // A pass that didn't wait still takes time on the PIC
+  if (hostMicros == lastMicros)
+  {
+    hostMicros += 1000;
+  }
+  lastMicros = hostMicros;
+  if (!fast)
+  {
+    elapsed = wallMicros() - wallStart;
+    if (hostMicros > elapsed)
+    {
+      usleep(hostMicros - elapsed);
+    }
+    else
+    {
+      hostMicros = elapsed;
+    }
+  }
+
+  count = read(ptyMaster, data, sizeof(data));
+  if (count > 0)
+  {
+    hostReceive(data, count);
+  }
+
+  ms = hostMicros / 1000;
+  if (hostKey && (ms >= keyReleaseMs))
+  {
+    hostKey = 0;
+  }
+  else if (!hostKey && (keyNext < keySteps) && (keyScript[keyNext].ms <= ms)
+           && (ms >= keyReleaseMs + KEY_HOLD_MS))
+  {
+    hostKey = keyScript[keyNext++].value;
+    keyReleaseMs = ms + KEY_HOLD_MS;
+  }
+
+  if (verbose && memcmp(lcdShown, hostLcd, sizeof(lcdShown)))
+  {
+    memcpy(lcdShown, hostLcd, sizeof(lcdShown));
+    for (row = 0 ; row < 2 ; row++)
+    {
+      fprintf(stderr, "%8u ms |%.16s|\n", ms, hostLcd[row]);
+    }
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  int               option;
+
+  while ((option = getopt(argc, argv, "a:c:e:fk:t:v")) != -1)
+  {
+    switch (option)
+    {
+    case 'a':
+      adcSteps = loadScript(optarg, adcScript, 0);
+      break;
+    case 'c':
+      if (sscanf(optarg, "%hhu,%hhu", &calibration[0], &calibration[1]) != 2)
+      {
+        fprintf(stderr, "-c takes the zero and full scale readings, as 30,220\n");
+        return (1);
+      }
+      break;
+    case 'e':
+      eepromPath = optarg;
+      break;
+    case 'f':
+      fast = 1;
+      break;
+    case 'k':
+      keySteps = loadScript(optarg, keyScript, 1);
+      break;
+    case 't':
+      tests = atoi(optarg);
+      if ((tests < 0) || (tests > TEST_MAX_SETS))
+      {
+        fprintf(stderr, "-t takes 0 to %d tests\n", TEST_MAX_SETS);
+        return (1);
+      }
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      fprintf(stderr, "Usage: %s -e image [-k keys] [-a adc] [-c zero,full] [-t tests] [-f] [-v]\n", argv[0]);
+      return (1);
+    }
+  }
+  if (!eepromPath)
+  {
+    fprintf(stderr, "An EEPROM image is needed (-e)\n");
+    return (1);
+  }
+
+  loadEeprom();
+  rtcTime(time(NULL), hostRtc);
+
+  openPty();
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  signal(SIGPIPE, SIG_IGN);
+  hostAdcHook = scriptAdc;
+  hostTxHook = sendByte;
+  hostYield = yield;
+  wallStart = wallMicros();
+  firmware_main();
+  saveEeprom();
+  return (0);
+}
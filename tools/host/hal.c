@@ -0,0 +1,406 @@
+//******************************************************************************
+//  Filename: hal.c
+//
+//  Description:
+//  ============
+//  Host models of the probe's peripherals.  See hal.h.
+//
+//******************************************************************************
+#include "hal.h"
+
+uint8_t             hostAdc;
+uint8_t             (*hostAdcHook)(void);
+uint8_t             hostEeprom[HOST_EEPROM_SIZE];
+uint8_t             hostEepromPresent = 1;
+uint8_t             hostKey;
+char                hostLcd[2][17] = {"                ", "                "};
+uint32_t            hostMicros;
+uint8_t             hostRtc[HOST_RTC_SIZE];
+uint8_t             hostRx[HOST_UART_SIZE];
+uint16_t            hostRxHead;
+uint16_t            hostRxTail;
+uint8_t             hostTx[HOST_UART_SIZE];
+uint32_t            hostTxCount;
+void                (*hostTxHook)(uint8_t data);
+void                (*hostYield)(void);
+uint8_t             kbd_port;
+uint8_t             lcd_port;
+
+static uint16_t     eepromPointer;
+static uint32_t     rtcMicros;                    // hostMicros at the last whole second
+static uint8_t      i2cCount;                     // Bytes since the start
+static uint8_t      i2cDevice;                    // Address byte after the start
+static uint8_t      lcdAddress;
+static uint8_t      pinA1;
+static uint8_t      pinA2;
+static uint8_t      pinA3;
+static uint8_t      rtcPointer;
+static uint8_t      tbeEnabled;
+static uint8_t      tbeRunning;
+
+
+//******************************************************************************
+//  Time
+//******************************************************************************
+void delay_ms(uint16_t ms)
+{
+  hostMicros += (uint32_t) ms * 1000;
+}
+
+
+void delay_us(uint16_t us)
+{
+  hostMicros += us;
+}
+
+
+uint16_t get_timer1(void)
+{
+  return ((uint16_t) (hostMicros / 8));
+}
+
+
+//******************************************************************************
+//  I2C: 24LC64 at 0xA0 and DS1307 at 0xD0
+//******************************************************************************
+static uint8_t bcdIncrement(uint8_t value)
+{
+  return ((value & 0x0f) == 9 ? (value & 0xf0) + 0x10 : value + 1);
+}
+
+
+// Advances the clock one second, in 12 or 24 hour mode as the hours register
+// says, unless the CH bit stops it
+static void rtcTick(void)
+{
+  static const uint8_t days[13] = {0, 0x31, 0x29, 0x31, 0x30, 0x31, 0x30, 0x31, 0x31, 0x30, 0x31, 0x30, 0x31};
+  uint8_t           last;
+
+  if (hostRtc[0] & 0x80)
+  {
+    return;
+  }
+  hostRtc[0] = bcdIncrement(hostRtc[0]);
+  if (hostRtc[0] < 0x60)
+  {
+    return;
+  }
+  hostRtc[0] = 0;
+  hostRtc[1] = bcdIncrement(hostRtc[1]);
+  if (hostRtc[1] < 0x60)
+  {
+    return;
+  }
+  hostRtc[1] = 0;
+  if (hostRtc[2] & 0x40)
+  {
+    // 12 hour mode: 11 goes to 12 and flips AM/PM, 12 goes to 1
+    switch (hostRtc[2] & 0x1f)
+    {
+    case 0x11:
+      hostRtc[2] = (hostRtc[2] ^ 0x20) + 1;
+      if (hostRtc[2] & 0x20)
+      {
+        return;                                   // Noon
+      }
+      break;                                      // Midnight
+    case 0x12:
+      hostRtc[2] = (hostRtc[2] & 0x60) | 0x01;
+      return;
+    default:
+      hostRtc[2] = (hostRtc[2] & 0x60) | bcdIncrement(hostRtc[2] & 0x1f);
+      return;
+    }
+  }
+  else
+  {
+    hostRtc[2] = bcdIncrement(hostRtc[2]);
+    if (hostRtc[2] < 0x24)
+    {
+      return;
+    }
+    hostRtc[2] = 0;
+  }
+  hostRtc[3] = (hostRtc[3] % 7) + 1;
+  last = days[(hostRtc[5] >> 4) * 10 + (hostRtc[5] & 0x0f)];
+  if ((last == 0x29) && (((hostRtc[6] >> 4) * 10 + (hostRtc[6] & 0x0f)) % 4))
+  {
+    last = 0x28;
+  }
+  if (hostRtc[4] < last)
+  {
+    hostRtc[4] = bcdIncrement(hostRtc[4]);
+    return;
+  }
+  hostRtc[4] = 1;
+  if (hostRtc[5] < 0x12)
+  {
+    hostRtc[5] = bcdIncrement(hostRtc[5]);
+    return;
+  }
+  hostRtc[5] = 1;
+  hostRtc[6] = (hostRtc[6] == 0x99) ? 0 : bcdIncrement(hostRtc[6]);
+}
+
+
+void i2c_start(void)
+{
+  // The clock counts the seconds since it was last looked at
+  while (hostMicros - rtcMicros >= 1000000)
+  {
+    rtcMicros += 1000000;
+    rtcTick();
+  }
+  i2cCount = 0;
+}
+
+
+void i2c_stop(void)
+{
+  i2cCount = 0;
+}
+
+
+uint8_t i2c_write(uint8_t data)
+{
+  uint8_t           count;
+
+  count = i2cCount++;
+  if (count == 0)
+  {
+    i2cDevice = data;
+    if ((data & 0xfe) == 0xa0)
+    {
+      return (hostEepromPresent ? 0 : 1);
+    }
+    return ((data & 0xfe) == 0xd0 ? 0 : 1);
+  }
+  if (i2cDevice == 0xa0)
+  {
+    if (count == 1)
+    {
+      eepromPointer = (uint16_t) (data << 8) & (HOST_EEPROM_SIZE - 1);
+    }
+    else if (count == 2)
+    {
+      eepromPointer |= data;
+    }
+    else
+    {
+      // Page writes wrap within the 32-byte page
+      hostEeprom[eepromPointer] = data;
+      eepromPointer = (eepromPointer & ~31) | ((eepromPointer + 1) & 31);
+    }
+  }
+  else if (i2cDevice == 0xd0)
+  {
+    if (count == 1)
+    {
+      rtcPointer = data % HOST_RTC_SIZE;
+    }
+    else
+    {
+      hostRtc[rtcPointer] = data;
+      rtcPointer = (rtcPointer + 1) % HOST_RTC_SIZE;
+    }
+  }
+  return (0);
+}
+
+
+uint8_t host_i2c_read(int *args, int count)
+{
+  uint8_t           data;
+
+  (void) args;
+  (void) count;
+  if (i2cDevice == 0xa1)
+  {
+    data = hostEeprom[eepromPointer];
+    eepromPointer = (eepromPointer + 1) & (HOST_EEPROM_SIZE - 1);
+    return (data);
+  }
+  if (i2cDevice == 0xd1)
+  {
+    data = hostRtc[rtcPointer];
+    rtcPointer = (rtcPointer + 1) % HOST_RTC_SIZE;
+    return (data);
+  }
+  return (0xff);
+}
+
+
+//******************************************************************************
+//  LCD on port D, keypad on port B
+//******************************************************************************
+void output_high(uint8_t pin)
+{
+  switch (pin)
+  {
+  case PIN_A1:
+    pinA1 = 1;
+    break;
+  case PIN_A2:
+    pinA2 = 1;
+    break;
+  case PIN_A3:
+    pinA3 = 1;
+    if (pinA2)
+    {
+      lcd_port = 0;                               // Never busy
+    }
+    break;
+  case PIN_B2:
+    kbd_port = (hostKey == 12) ? 0x10 : (hostKey == 13) ? 0x20 : 0;
+    break;
+  case PIN_B3:
+    if (hostYield)
+    {
+      hostYield();
+    }
+    kbd_port = (hostKey == 2) ? 0x10 : (hostKey == 3) ? 0x20 : 0;
+    break;
+  }
+}
+
+
+void output_low(uint8_t pin)
+{
+  switch (pin)
+  {
+  case PIN_A1:
+    pinA1 = 0;
+    break;
+  case PIN_A2:
+    pinA2 = 0;
+    break;
+  case PIN_A3:
+    if (pinA3 && !pinA2)
+    {
+      // Latch on the falling edge of E
+      if (pinA1)
+      {
+        if ((lcdAddress & 0x3f) < 16)
+        {
+          hostLcd[lcdAddress >> 6][lcdAddress & 0x3f] = (char) lcd_port;
+        }
+        ++lcdAddress;
+      }
+      else if (lcd_port == 0x01)
+      {
+        memcpy(hostLcd[0], "                ", 16);
+        memcpy(hostLcd[1], "                ", 16);
+        lcdAddress = 0;
+      }
+      else if (lcd_port & 0x80)
+      {
+        lcdAddress = lcd_port & 0x7f;
+      }
+    }
+    pinA3 = 0;
+    break;
+  case PIN_B2:
+  case PIN_B3:
+    kbd_port = 0;
+    break;
+  }
+}
+
+
+//******************************************************************************
+//  ADC
+//******************************************************************************
+uint8_t read_adc(void)
+{
+  return (hostAdcHook ? hostAdcHook() : hostAdc);
+}
+
+
+//******************************************************************************
+//  UART: the transmit interrupt runs as long as it is enabled
+//******************************************************************************
+void disable_interrupts(uint8_t mask)
+{
+  if (mask & INT_TBE)
+  {
+    tbeEnabled = 0;
+  }
+}
+
+
+void enable_interrupts(uint8_t mask)
+{
+  if (mask & INT_TBE)
+  {
+    tbeEnabled = 1;
+  }
+  if (tbeRunning)
+  {
+    return;
+  }
+  tbeRunning = 1;
+  while (tbeEnabled)
+  {
+    Peripheral_transmitUART();
+  }
+  tbeRunning = 0;
+}
+
+
+uint8_t host_getc(void)
+{
+  uint8_t           data;
+
+  while (hostRxHead == hostRxTail)
+  {
+    hostMicros += 1000;
+    if (hostYield)
+    {
+      hostYield();
+    }
+  }
+  data = hostRx[hostRxTail];
+  hostRxTail = (uint16_t) (hostRxTail + 1) % HOST_UART_SIZE;
+  return (data);
+}
+
+
+void hostReceive(const uint8_t *data, uint16_t count)
+{
+  while (count--)
+  {
+    hostRx[hostRxHead] = *data++;
+    hostRxHead = (uint16_t) (hostRxHead + 1) % HOST_UART_SIZE;
+  }
+}
+
+
+uint8_t kbhit(void)
+{
+  if ((hostRxHead == hostRxTail) && hostYield)
+  {
+    hostYield();
+  }
+  return (hostRxHead != hostRxTail);
+}
+
+
+void host_putc(uint8_t data)
+{
+  hostMicros += 1042;                             // 10 bits at 9600 baud
+  if (hostTxHook)
+  {
+    hostTxHook(data);
+  }
+  else if (hostTxCount < HOST_UART_SIZE)
+  {
+    hostTx[hostTxCount++] = data;
+  }
+}
+
+
+// Firmware older than the interrupt-driven UART has no transmit interrupt
+__attribute__((weak)) void Peripheral_transmitUART(void)
+{
+  disable_interrupts(INT_TBE);
+}
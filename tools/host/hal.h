@@ -0,0 +1,122 @@
+//******************************************************************************
+//  Filename: hal.h
+//
+//  Description:
+//  ============
+//  Host stand-in for the CCS device header and built-in functions, so the
+//  firmware can be compiled with gcc by tools/hostbuild.py.  It models the
+//  parts the firmware talks to: the 24LC64 EEPROM and DS1307 clock on I2C,
+//  the HD44780 LCD on port D, the keypad on port B, the ADC, the UART and
+//  Timer1.  Time only passes in the delay functions (and while getc()
+//  waits), and the clock ticks with it.
+//
+//  The CCS types are mapped by hostbuild.py: int is 8 bits and long is 16
+//  bits, as on the PIC.  gcc still promotes arithmetic to 32 bits where CCS
+//  does not, so a host build checks the math, not CCS's 8/16-bit truncation.
+//
+//******************************************************************************
+#ifndef HAL_H
+#define HAL_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t                         byte;
+
+#define true                            1
+#define false                           0
+#define TRUE                            1
+#define FALSE                           0
+
+// Pins the firmware drives
+#define PIN_A1                          0x51
+#define PIN_A2                          0x52
+#define PIN_A3                          0x53
+#define PIN_B2                          0x62
+#define PIN_B3                          0x63
+#define PIN_C3                          0x73
+#define PIN_C4                          0x74
+#define PIN_C6                          0x76
+#define PIN_C7                          0x77
+
+// Setup constants
+#define ADC_CLOCK_INTERNAL              0
+#define A_ANALOG                        1
+#define NO_ANALOGS                      0
+#define T1_INTERNAL                     0x85
+#define T1_DIV_BY_8                     0x30
+#define GLOBAL                          0x80
+#define INT_TBE                         0x01
+#define INT_RDA                         0x02
+
+// Built-ins that are macros
+#define bit_test(x, n)                  ((((x) >> (n)) & 1) != 0)
+#define delay_cycles(n)
+#define make8(x, n)                     ((uint8_t) ((x) >> (8 * (n))))
+#define set_adc_channel(n)
+#define set_tris_a(n)
+#define set_tris_b(n)
+#define set_tris_d(n)
+#define setup_adc(n)
+#define setup_port_a(n)
+#define setup_timer_1(n)
+#define swap(x)                         ((x) = (uint8_t) (((x) << 4) | ((x) >> 4)))
+#define i2c_read(...)                   host_i2c_read((int[]) {1, ##__VA_ARGS__}, sizeof((int[]) {1, ##__VA_ARGS__}) / sizeof(int))
+
+// The CCS rs232 names, kept apart from stdio's
+#undef getc
+#undef putc
+#define getc                            host_getc
+#define putc                            host_putc
+
+// Ports
+extern uint8_t                          kbd_port;
+extern uint8_t                          lcd_port;
+
+// Built-ins that are functions
+void                                    delay_ms(uint16_t ms);
+void                                    delay_us(uint16_t us);
+void                                    disable_interrupts(uint8_t mask);
+void                                    enable_interrupts(uint8_t mask);
+uint16_t                                get_timer1(void);
+uint8_t                                 host_getc(void);
+uint8_t                                 host_i2c_read(int *args, int count);
+void                                    i2c_start(void);
+void                                    i2c_stop(void);
+uint8_t                                 i2c_write(uint8_t data);
+uint8_t                                 kbhit(void);
+void                                    output_high(uint8_t pin);
+void                                    output_low(uint8_t pin);
+void                                    host_putc(uint8_t data);
+uint8_t                                 read_adc(void);
+
+// Device state, for the drivers
+#define HOST_EEPROM_SIZE                8192
+#define HOST_RTC_SIZE                   64
+#define HOST_UART_SIZE                  65536
+
+extern uint8_t                          hostAdc;                    // Next ADC reading
+extern uint8_t                          (*hostAdcHook)(void);       // Overrides hostAdc
+extern uint8_t                          hostEeprom[HOST_EEPROM_SIZE];
+extern uint8_t                          hostEepromPresent;          // 0: never ACKs
+extern uint8_t                          hostKey;                    // Key held: 2, 3, 12, 13 or 0
+extern char                             hostLcd[2][17];             // Text on the LCD
+extern uint8_t                          hostRtc[HOST_RTC_SIZE];
+extern uint8_t                          hostRx[HOST_UART_SIZE];
+extern uint16_t                         hostRxHead;
+extern uint16_t                         hostRxTail;
+extern uint8_t                          hostTx[HOST_UART_SIZE];
+extern uint32_t                         hostTxCount;
+extern void                             (*hostTxHook)(uint8_t data);
+extern uint32_t                         hostMicros;                 // Time passed in delays
+extern void                             (*hostYield)(void);         // Called on each key scan and UART poll
+
+void                                    hostReceive(const uint8_t *data, uint16_t count);
+
+// The firmware's transmit interrupt
+void                                    Peripheral_transmitUART(void);
+
+#endif
@@ -0,0 +1,225 @@
+//******************************************************************************
+//  Filename: sweep.c
+//
+//  Description:
+//  ============
+//  Driver for tools/sweep.py: runs the firmware's strength math for every
+//  ADC reading (0 to 255), every calibration (zero + 1 < full scale) and
+//  every power, MOH and weight setting, and writes a coverage report as CSV
+//  to the standard output.  The math is Display_calculateScale(),
+//  Display_calculateDistance() and Display_calculatePressure(), which use
+//  only their arguments, so the settings are shared out between threads with
+//  nothing else in common.  Density is stored with each test but is not an
+//  input of the math, so it is not swept.
+//
+//  One row per setting and units:
+//
+//    cases       readings and calibrations swept
+//    below_zero  readings below the zero reading
+//    zero        pressures of 0, which is what the math gives below the
+//                setting's minimum distance
+//    wrapped     pressures that wrapped below 0 (int32 is unsigned)
+//    unreadable  pressures of more than DISPLAY_DIGITS digits in the units
+//    shown_min   the smallest and largest of the rest, as
+//    shown_max   Display_updateDisplayPressure() shows them (0.1 MPa or psi)
+//
+//  Usage: sweep [-j threads]
+//
+//******************************************************************************
+#include <pthread.h>
+#include <unistd.h>
+
+#define SETTING_GROUPS                  ((SUBMENU_POWER_HIGH - SUBMENU_POWER_STD + 1)             \
+                                         * (SUBMENU_MOH_7 - SUBMENU_MOH_3 + 1)                    \
+                                         * (SUBMENU_WEIGHT_SUPER_LOW - SUBMENU_WEIGHT_HIGH + 1))
+#define SHOWN_LIMIT                     100000    // DISPLAY_DIGITS digits
+#define WRAPPED                         0x80000000
+
+typedef struct
+{
+  uint8_t           power;
+  uint8_t           mohs;
+  uint8_t           weight;
+  uint32_t          cases;
+  uint32_t          belowZero;
+  uint32_t          zero;
+  uint32_t          wrapped;
+  uint32_t          unreadable[2];                // MPa, psi
+  uint32_t          shownMin[2];
+  uint32_t          shownMax[2];
+} Coverage;
+
+static Coverage     coverage[SETTING_GROUPS];
+static int          coverageNext;
+static pthread_mutex_t coverageLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const uint32_t PRESSURE_MULT[2] = {PRESSURE_MULT_METRIC, PRESSURE_MULT_IMPERIAL};
+
+
+// Sweeps one setting.  The readings of each calibration go through the math
+// into one array first, and are then counted in a second, branch-light loop.
+static void sweepSetting(Coverage *c)
+{
+  int               full;
+  uint32_t          pressure[256];
+  int               reading;
+  uint16_t          scale;
+  uint64_t          shown;
+  int               units;
+  int               zero;
+
+  c->shownMin[0] = c->shownMin[1] = 0xffffffff;
+  for (zero = 0 ; zero < 256 ; zero++)
+  for (full = zero + 2 ; full < 256 ; full++)
+  {
+    scale = Display_calculateScale(zero, full);
+    for (reading = 0 ; reading < 256 ; reading++)
+    {
+      pressure[reading] = Display_calculatePressure(Display_calculateDistance(reading, zero, scale),
+                                                    c->power, c->mohs, c->weight);
+    }
+
+    c->cases += 256;
+    c->belowZero += zero;
+    for (reading = 0 ; reading < 256 ; reading++)
+    {
+      if (pressure[reading] >= WRAPPED)
+      {
+        ++c->wrapped;
+        continue;
+      }
+      c->zero += !pressure[reading];
+      for (units = 0 ; units < 2 ; units++)
+      {
+        shown = ((uint64_t) pressure[reading] * PRESSURE_MULT[units]) >> PRESSURE_SHIFT;
+        if (shown >= SHOWN_LIMIT)
+        {
+          ++c->unreadable[units];
+          continue;
+        }
+        if (shown < c->shownMin[units])
+        {
+          c->shownMin[units] = shown;
+        }
+        if (shown > c->shownMax[units])
+        {
+          c->shownMax[units] = shown;
+        }
+      }
+    }
+  }
+}
+
+
+static void *sweepSettings(void *unused)
+{
+  Coverage          *c;
+
+  (void) unused;
+  while (1)
+  {
+    pthread_mutex_lock(&coverageLock);
+    c = (coverageNext < SETTING_GROUPS) ? &coverage[coverageNext++] : NULL;
+    pthread_mutex_unlock(&coverageLock);
+    if (!c)
+    {
+      return (NULL);
+    }
+    sweepSetting(c);
+  }
+}
+
+
+// Writes a setting's label, as the probe shows it in the units
+static void printLabel(uint8_t value, int units)
+{
+  const char        *label;
+  int               length;
+
+  label = LABEL_TEXT[SETTING_LABEL[units][value]];
+  length = strlen(label);
+  while (length && (label[length - 1] == ' '))
+  {
+    --length;
+  }
+  if (length)
+  {
+    printf("%.*s,", length, label);
+  }
+  else
+  {
+    printf("%d,", value);
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  Coverage          *c;
+  int               i;
+  int               mohs;
+  int               option;
+  int               power;
+  int               threadCount;
+  pthread_t         *threads;
+  int               units;
+  int               weight;
+
+  threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+  while ((option = getopt(argc, argv, "j:")) != -1)
+  {
+    if (option != 'j')
+    {
+      fprintf(stderr, "Usage: %s [-j threads]\n", argv[0]);
+      return (1);
+    }
+    threadCount = atoi(optarg);
+  }
+  if (threadCount < 1)
+  {
+    threadCount = 1;
+  }
+
+  c = coverage;
+  for (power = SUBMENU_POWER_STD ; power <= SUBMENU_POWER_HIGH ; power++)
+  for (mohs = SUBMENU_MOH_3 ; mohs <= SUBMENU_MOH_7 ; mohs++)
+  for (weight = SUBMENU_WEIGHT_HIGH ; weight <= SUBMENU_WEIGHT_SUPER_LOW ; weight++)
+  {
+    c->power = power;
+    c->mohs = mohs;
+    c->weight = weight;
+    ++c;
+  }
+
+  threads = calloc(threadCount, sizeof(pthread_t));
+  for (i = 0 ; i < threadCount ; i++)
+  {
+    pthread_create(&threads[i], NULL, sweepSettings, NULL);
+  }
+  for (i = 0 ; i < threadCount ; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  printf("power,mohs,weight,units,cases,below_zero,zero,wrapped,unreadable,shown_min,shown_max\n");
+  for (c = coverage ; c < coverage + SETTING_GROUPS ; c++)
+  {
+    for (units = 0 ; units < 2 ; units++)
+    {
+      printLabel(c->power, units);
+      printLabel(c->mohs, units);
+      printLabel(c->weight, units);
+      printLabel(SUBMENU_UNITS_MPA + units, units);
+      printf("%u,%u,%u,%u,%u,", c->cases, c->belowZero, c->zero, c->wrapped, c->unreadable[units]);
+      if (c->shownMin[units] > c->shownMax[units])
+      {
+        printf(",\n");
+      }
+      else
+      {
+        printf("%u,%u\n", c->shownMin[units], c->shownMax[units]);
+      }
+    }
+  }
+  return (0);
+}
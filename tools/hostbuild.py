@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: hostbuild.py
+#
+#  Description:
+#  ============
+#  Builds the Windsor firmware for the host with gcc, so the host checks in
+#  tools/ can run it against the models in tools/host/hal.c.  The CCS source
+#  is translated to C99:
+#
+#    - <16F77.h> becomes tools/host/hal.h and Windsor.h is read in line.
+#    - #fuses, #use, #byte, #locate, #inline, #separate and #int_xxx go away,
+#      and each #bit flag becomes a variable of its own.
+#    - The CCS types get their PIC sizes: int is 8 bits, long is 16 bits and
+#      both are unsigned unless declared signed.  short int is one bit.
+#    - Structures are packed, as on the PIC, so the blocks the firmware
+#      copies to and from the EEPROM keep their size and layout.
+#    - CCS identifiers are not case sensitive, so each one is given a single
+#      spelling.  Type names keep theirs, as "Settings settings;" needs both.
+#    - main() becomes firmware_main().
+#
+#  A check appends its own C code (its driver) to the translated firmware, so
+#  the driver sees the firmware's static functions and globals.  Any git
+#  revision can be built, which is how a check compares the firmware before
+#  and after a change.
+#
+#  Usage: tools/hostbuild.py [revision] [-o file.c]
+#    Writes the translated source of the revision (or the working tree) to
+#    file.c, or to the standard output.
+#
+#******************************************************************************
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.dirname(TOOLS)
+HOST = os.path.join(TOOLS, "host")
+
+C_KEYWORDS = {
+  "break", "case", "char", "const", "continue", "default", "do", "else",
+  "enum", "float", "for", "if", "int", "long", "return", "short", "signed",
+  "sizeof", "static", "struct", "switch", "typedef", "unsigned", "void",
+  "while",
+}
+
+# CCS types to C99, longest first
+TYPES = [
+  (r"\bsigned\s+int32\b", "int32_t"),
+  (r"\bsigned\s+long\b", "int16_t"),
+  (r"\bsigned\s+int8\b", "int8_t"),
+  (r"\bsigned\s+int\b", "int8_t"),
+  (r"\bunsigned\s+int\b", "uint8_t"),
+  (r"\bshort\s+int\b", "_Bool"),
+  (r"\bint1\b", "_Bool"),
+  (r"\bint32\b", "uint32_t"),
+  (r"\bint16\b", "uint16_t"),
+  (r"\bint8\b", "uint8_t"),
+  (r"\blong\b", "uint16_t"),
+  (r"\bint\b", "uint8_t"),
+  (r"\bsigned\b", "int8_t"),
+]
+
+TOKENS = re.compile(r'//[^\n]*|/\*.*?\*/|"(?:\\.|[^"\\\n])*"|\'(?:\\.|[^\'\\\n])*\'', re.S)
+
+
+#******************************************************************************
+#
+#  Function: read_source()
+#
+#  Description:
+#  ============
+#  Returns a file of the revision, or of the working tree if revision is
+#  None, with the line ends made plain.
+#
+#******************************************************************************
+def read_source(name, revision=None):
+  if revision is None:
+    text = open(os.path.join(REPO, name), errors="replace").read()
+  else:
+    text = subprocess.run(["git", "-C", REPO, "show", "%s:%s" % (revision, name)],
+                          check=True, stdout=subprocess.PIPE).stdout.decode("latin-1")
+  return text.replace("\r\n", "\n")
+
+
+#******************************************************************************
+#
+#  Function: map_code()
+#
+#  Description:
+#  ============
+#  Applies the function to the code between the comments, strings and
+#  character constants of the text.
+#
+#******************************************************************************
+def map_code(text, function):
+  pieces = []
+  last = 0
+  for match in TOKENS.finditer(text):
+    pieces.append(function(text[last:match.start()]))
+    pieces.append(match.group(0))
+    last = match.end()
+  pieces.append(function(text[last:]))
+  return "".join(pieces)
+
+
+#******************************************************************************
+#
+#  Function: spellings()
+#
+#  Description:
+#  ============
+#  Returns the spelling to use for each identifier, keyed by its lower case:
+#  C keywords in lower case, the host header's names as the header spells
+#  them and the rest as the firmware spells them most often.
+#
+#******************************************************************************
+def spellings(text, hal):
+  counts = {}
+  def count(code):
+    for name in re.findall(r"\b[A-Za-z_]\w*\b", code):
+      counts.setdefault(name.lower(), {})
+      counts[name.lower()][name] = counts[name.lower()].get(name, 0) + 1
+    return code
+  map_code(text, count)
+  typedefs = {name.lower() for name in re.findall(r"\}\s*(\w+)\s*;", map_code(text, lambda code: code))}
+  hal_names = {}
+  for name in re.findall(r"\b[A-Za-z_]\w*\b", map_code(hal, lambda code: code)):
+    hal_names.setdefault(name.lower(), name)
+  chosen = {}
+  for lower, names in counts.items():
+    if (len(names) == 1 and lower not in hal_names) or lower in typedefs:
+      continue
+    if lower in C_KEYWORDS:
+      chosen[lower] = lower
+    elif lower in hal_names:
+      chosen[lower] = hal_names[lower]
+    else:
+      chosen[lower] = max(sorted(names), key=lambda name: names[name])
+  return chosen
+
+
+#******************************************************************************
+#
+#  Function: translate()
+#
+#  Description:
+#  ============
+#  Returns the firmware of the revision as C99 for gcc.  Extra #defines (such
+#  as "AUTO_ADVANCE" or "SLOPE_SMALL_3_MPA 185") go ahead of everything else,
+#  and replace the firmware's own of the same name.
+#
+#******************************************************************************
+def translate(revision=None, defines=()):
+  source = read_source("Windsor.c", revision)
+  header = read_source("Windsor.h", revision)
+  source = re.sub(r'^#include\s+"Windsor.h"[^\n]*$', lambda m: header, source, flags=re.M)
+  source = re.sub(r"^#include\s+<16F77.h>[^\n]*$", '#include "hal.h"', source, flags=re.M)
+  for define in defines:
+    source = re.sub(r"^\s*#\s*define\s+%s\b[^\n]*$" % re.escape(define.split()[0]), "", source,
+                    flags=re.M | re.I)
+
+  lines = []
+  for line in source.split("\n"):
+    directive = re.match(r"\s*#\s*(\w+)", line)
+    if directive:
+      word = directive.group(1).lower()
+      if word in ("fuses", "use", "byte", "locate", "inline", "separate") or word.startswith("int_"):
+        line = ""
+      elif word == "bit":
+        flag = re.match(r"\s*#\s*bit\s+(\w+)", line)
+        line = "short int %s;" % flag.group(1)
+    lines.append(line)
+  source = "\n".join(lines)
+
+  hal = open(os.path.join(HOST, "hal.h")).read()
+  chosen = spellings(source, hal)
+
+  def code(text):
+    text = re.sub(r"\b[A-Za-z_]\w*\b", lambda m: chosen.get(m.group(0).lower(), m.group(0)), text)
+    for pattern, replacement in TYPES:
+      text = re.sub(pattern, replacement, text)
+    text = re.sub(r"\[\s*\*\s*\]", "[32]", text)
+    text = re.sub(r"\btypedef\s+struct\b", "typedef struct __attribute__((packed))", text)
+    text = re.sub(r"\bmain\s*\(", "firmware_main(", text)
+    return text
+
+  prefix = "".join("#define %s\n" % define for define in defines)
+  return prefix + map_code(source, code)
+
+
+#******************************************************************************
+#
+#  Function: build()
+#
+#  Description:
+#  ============
+#  Compiles the revision with the driver appended and returns the path of
+#  the program.
+#
+#******************************************************************************
+def build(driver, revision=None, defines=(), name="host"):
+  directory = tempfile.mkdtemp(prefix="windsor-")
+  source = os.path.join(directory, name + ".c")
+  program = os.path.join(directory, name)
+  with open(source, "w") as output:
+    output.write(translate(revision, defines))
+    output.write("\n\n// Driver\n")
+    output.write(driver)
+  subprocess.run(["gcc", "-std=gnu99", "-D_GNU_SOURCE", "-w", "-funsigned-char", "-O2", "-pthread", "-I", HOST,
+                  "-o", program, source, os.path.join(HOST, "hal.c"), "-lm"], check=True)
+  return program
+
+
+#******************************************************************************
+#
+#  Function: run()
+#
+#  Description:
+#  ============
+#  Builds the revision with the driver, runs it and returns its output.
+#
+#******************************************************************************
+def run(driver, revision=None, defines=(), arguments=(), data=b""):
+  program = build(driver, revision, defines)
+  return subprocess.run([program] + list(arguments), input=data, check=True,
+                        stdout=subprocess.PIPE).stdout.decode("latin-1")
+
+
+def main():
+  arguments = sys.argv[1:]
+  output = None
+  if "-o" in arguments:
+    output = arguments[arguments.index("-o") + 1]
+    del arguments[arguments.index("-o"):arguments.index("-o") + 2]
+  text = translate(arguments[0] if arguments else None)
+  if output:
+    open(output, "w").write(text)
+  else:
+    sys.stdout.write(text)
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: probe.py
+#
+#  Description:
+#  ============
+#  Command line client for the probe's serial protocol (see the README).  It
+#  opens the probe's serial port, or the pty of an emulated probe from
+#  tools/emulator.py, and either asks for part of the stored tests with the
+#  query commands or takes a download.  The probe answers only while
+#  Download Tests shows "Connect PC".  Each test is printed on one line: its
+#  time, the six settings, the calibration and the three shot readings.
+#
+#  Usage: tools/probe.py port command [arguments]
+#    records first last   the tests from first to last (1-based)
+#    since "YYYY-MM-DD HH:MM"
+#                         the tests at or after the time
+#    settings             the six settings
+#    calibration          the zero and full scale readings
+#    download [-a]        waits for Enter at "Connect PC" and prints the
+#                         download; -a acknowledges each test, so the next
+#                         download starts after the last one
+#
+#******************************************************************************
+import argparse
+import datetime
+import os
+import select
+import sys
+import termios
+import tty
+
+ACK = 0x06
+TEST_SIZE = 16
+TESTS_MAX = 99
+REPLY_TIMEOUT = 2.0                               # Seconds, per reply
+DOWNLOAD_TIMEOUT = 60.0                           # Seconds to wait for Enter
+
+SETTING_NAMES = ["power", "density", "weight", "mohs", "units", "aggsize"]
+
+
+class ProbeError(Exception):
+  pass
+
+
+#******************************************************************************
+#
+#  Function: open_port()
+#
+#  Description:
+#  ============
+#  Opens the serial port or pty at 9600 baud, 8N1, with no translation of
+#  the bytes either way.
+#
+#******************************************************************************
+def open_port(path):
+  port = os.open(path, os.O_RDWR | os.O_NOCTTY)
+  tty.setraw(port)
+  settings = termios.tcgetattr(port)
+  settings[4] = settings[5] = termios.B9600
+  termios.tcsetattr(port, termios.TCSANOW, settings)
+  termios.tcflush(port, termios.TCIOFLUSH)
+  return port
+
+
+#******************************************************************************
+#
+#  Function: receive()
+#
+#  Description:
+#  ============
+#  Returns the next "count" bytes from the probe with the 48 it adds to each
+#  taken off.  Raises ProbeError if they don't arrive within "timeout"
+#  seconds.
+#
+#******************************************************************************
+def receive(port, count, timeout=REPLY_TIMEOUT):
+  data = b""
+  while len(data) < count:
+    if not select.select([port], [], [], timeout)[0]:
+      raise ProbeError("the probe sent %d of %d bytes" % (len(data), count))
+    data += os.read(port, count - len(data))
+  return bytes((byte - 48) & 0xff for byte in data)
+
+
+# Reads a count byte and that many tests, acknowledging the first "acks"
+def receive_tests(port, timeout=REPLY_TIMEOUT, acks=0):
+  count = receive(port, 1, timeout)[0]
+  tests = []
+  for _ in range(count):
+    tests.append(receive(port, TEST_SIZE))
+    if len(tests) <= acks:
+      os.write(port, bytes([ACK]))
+  return tests
+
+
+def records(port, first, last):
+  os.write(port, b"R" + bytes([first, last]))
+  return receive_tests(port)
+
+
+# The time is the five BCD bytes of a test, in the clock's 12 or 24 hour form
+def since(port, time):
+  os.write(port, b"T" + bytes(time))
+  return receive_tests(port)
+
+
+def settings(port):
+  os.write(port, b"S")
+  return list(receive(port, len(SETTING_NAMES)))
+
+
+def calibration(port):
+  os.write(port, b"C")
+  return list(receive(port, 2))
+
+
+def download(port, acks=0):
+  return receive_tests(port, DOWNLOAD_TIMEOUT, acks)
+
+
+def bcd(value):
+  return (value // 10) << 4 | value % 10
+
+
+def from_bcd(value):
+  return (value >> 4) * 10 + (value & 0x0f)
+
+
+# Returns the five BCD bytes of a test time, with the hours in 24 hour form
+def encode_time(when):
+  return [bcd(when.minute), bcd(when.hour), bcd(when.day), bcd(when.month), bcd(when.year % 100)]
+
+
+def format_test(test):
+  hours = test[1]
+  if hours & 0x40:
+    hours = from_bcd(hours & 0x1f) % 12 + (12 if hours & 0x20 else 0)
+  else:
+    hours = from_bcd(hours & 0x3f)
+  return "20%02d-%02d-%02d %02d:%02d  settings %s  calibration %d %d  shots %d %d %d" % (
+    from_bcd(test[4]), from_bcd(test[3]), from_bcd(test[2]), hours, from_bcd(test[0]),
+    " ".join(str(value) for value in test[5:11]), test[11], test[12], test[13], test[14], test[15])
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Query a probe over its serial port.")
+  parser.add_argument("port")
+  commands = parser.add_subparsers(dest="command", required=True)
+  command = commands.add_parser("records")
+  command.add_argument("first", type=int)
+  command.add_argument("last", type=int)
+  command = commands.add_parser("since")
+  command.add_argument("time", type=lambda text: datetime.datetime.strptime(text, "%Y-%m-%d %H:%M"))
+  commands.add_parser("settings")
+  commands.add_parser("calibration")
+  command = commands.add_parser("download")
+  command.add_argument("-a", action="store_true", dest="ack")
+  arguments = parser.parse_args()
+
+  port = open_port(arguments.port)
+  try:
+    if arguments.command == "records":
+      tests = records(port, arguments.first, arguments.last)
+    elif arguments.command == "since":
+      tests = since(port, encode_time(arguments.time))
+    elif arguments.command == "download":
+      tests = download(port, TESTS_MAX if arguments.ack else 0)
+    elif arguments.command == "settings":
+      print(" ".join("%s=%d" % pair for pair in zip(SETTING_NAMES, settings(port))))
+      return 0
+    else:
+      print("zero=%d full=%d" % tuple(calibration(port)))
+      return 0
+  except ProbeError as error:
+    print("%s: %s" % (arguments.port, error), file=sys.stderr)
+    return 1
+  for test in tests:
+    print(format_test(test))
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+#******************************************************************************
+#
+#  File: sweep.py
+#
+#  Description:
+#  ============
+#  Sweeps the firmware's strength math over every ADC reading, calibration
+#  and power, MOH and weight setting, in both units, and writes a coverage
+#  report as CSV: for each setting, how many cases give 0, wrap below 0 or
+#  have too many digits to show, and the range of the rest.  This is how new
+#  OFFSET_* and SLOPE_* values are checked before they go on a probe.
+#
+#  The sweep is the firmware built for the host by tools/hostbuild.py with
+#  the driver in tools/host/sweep.c, which describes the columns.  Values
+#  given as NAME=value ("OFFSET_SMALL_3_MPA=440") replace the firmware's.
+#
+#  Usage: tools/sweep.py [-j threads] [-o file.csv] [NAME=value ...]
+#    -j  the number of threads (one per processor)
+#    -o  the CSV file, in place of the standard output
+#
+#******************************************************************************
+import argparse
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hostbuild
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Sweep the strength math and report its coverage.")
+  parser.add_argument("-j", type=int, default=os.cpu_count(), dest="threads")
+  parser.add_argument("-o", dest="output")
+  parser.add_argument("values", nargs="*")
+  arguments = parser.parse_args()
+
+  driver = open(os.path.join(hostbuild.HOST, "sweep.c")).read()
+  defines = [value.replace("=", " ", 1) for value in arguments.values]
+  program = hostbuild.build(driver, None, defines, name="sweep")
+  output = open(arguments.output, "w") if arguments.output else None
+  return subprocess.run([program, "-j", str(arguments.threads)], stdout=output).returncode
+
+
+if __name__ == "__main__":
+  sys.exit(main())